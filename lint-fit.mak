@@ -38,6 +38,7 @@ SRCS = \
 	src/serialFit.c \
 	src/serialEchoFit.c \
 	src/serialPortFit.c \
+	src/serialLib.c \
 	src/todFit.c
 
 RDIR	 := lobs
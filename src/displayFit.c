@@ -199,6 +199,8 @@ ftRet_t displayFit (plint argc, char * const argv[] )
     } // while(opt != -1)
   }
 
+  ftArgsDone();
+
   if (getOut)
   {
     return retVal;
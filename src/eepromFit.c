@@ -2351,6 +2351,8 @@ ftRet_t eepromFit(plint argc, char * const argv[])
     break;
   }
 
+  ftArgsDone();
+
   if (getOut)
   {
     return retval;
@@ -616,6 +616,8 @@ static int32 parseEthArguments (plint argc, char * const argv[])
     c = getopt (argc, argv, "-o:t:c:h");
   }
 
+  ftArgsDone();
+
   if (pingOctet[0] == '\0') // Ping octet un-initialized
   {
     strcpy (pingOctet, DEFAULT_PING_OCTET);
@@ -22,6 +22,8 @@
 
 *******************************************************************************/
 
+#define _GNU_SOURCE // pthread_setaffinity_np()
+
 #include <ctype.h>
 #include <time.h>
 #include <signal.h>
@@ -47,163 +49,177 @@
 #define RETRY_COUNT 10
 #define RXTMO       10 // receive timeout in seconds
 #define MONITOR_REG 17u
-#define ZEROSx8     0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00
-#define ZEROSx16    ZEROSx8 , ZEROSx8
-#define ZEROSx32    ZEROSx16 , ZEROSx16
-#define ZEROSx64    ZEROSx32 , ZEROSx32
-#define ZEROSx128   ZEROSx64 , ZEROSx64
-#define ZEROSx256   ZEROSx128 , ZEROSx128
-#define ZEROSx512   ZEROSx256 , ZEROSx256
+#define FIO_FRAMES  4u // frames of one cycle
+#define FIO_HZ_MAX  1000u
+#define FIO_CLOCK   CLOCK_MONOTONIC_RAW // transaction time stamps, NTP does not slew it
+#define FIO_ADDR    0x14u // FIO SDLC address
+#define FIO_CTRL    0x83u // unnumbered information
+#define FIO_HDR     3u    // address, control and frame type
+#define FIO_RX_INPUTS 0u  // response size: input frame of the module in use
+#define FIO_FILTER  0x05u // on and off filter of an input
+#define FIO_FLT(n)  (n),FIO_FILTER,FIO_FILTER
+#define FIO_FLT8(n) FIO_FLT(n),FIO_FLT((n)+1u),FIO_FLT((n)+2u),FIO_FLT((n)+3u), \
+                    FIO_FLT((n)+4u),FIO_FLT((n)+5u),FIO_FLT((n)+6u),FIO_FLT((n)+7u)
 
 /*
 * global data
 */
 static u_int8 rxBuf[1024] = {0}; // global response buffer
-static const char *devName = "/dev/sp5s";
+static const char *devName = "sp5s";
 static int32 sp5s_fd;
 static u_int8 modId = 0;
+static bool fioDump = true; // hex dump every frame, not when cycling
+static struct timeval fioRxTmo = {RXTMO,0};
 
+/*
+* An FIO command: the frame type, the payload following it and the size of
+* the response. fioBuild() puts address and control in front.
+*/
 typedef struct _fioComm {
-  size_t txsz,rxsz;
-  u_int8 txCmd[1024];
+  u_int8        type;
+  size_t        rxsz;  // FIO_RX_INPUTS for the input frame size of the module
+  size_t        len;   // payload bytes
+  const u_int8 *data;
 } fioComm_t;
 
-static fioComm_t getModuleIdCmd[] = {
-  {3,4,{0x14,0x83,0x3c  //  command to get module ID
-  ,0x00,0x00,0x00,0x00,0x00
-  ,ZEROSx8,ZEROSx16,ZEROSx32,ZEROSx64,ZEROSx128,ZEROSx256,ZEROSx512}},
-  {0,0,{0}}
-};
+#define FIO_CMD(type,rxsz,data) {(type),(rxsz),sizeof(data),(data)}
+#define FIO_CMD0(type,rxsz)     {(type),(rxsz),0u,NULL}
 
-static fioComm_t getRawInputsCmd2[] = {
-  {3,15,{0x14,0x83,0x34   // command to get -2 raw inputs
-  ,0x00,0x00,0x00,0x00,0x00
-  ,ZEROSx8,ZEROSx16,ZEROSx32,ZEROSx64,ZEROSx128,ZEROSx256,ZEROSx512}},
-  {0,0,{0}}
-};
+static u_int8 txBuf[512]; // frame under transmission, see fioBuild()
 
-static fioComm_t getRawInputsCmd8[] = {
-  {3,22,{0x14,0x83,0x34   // command to get -8 raw inputs
-  ,0x00,0x00,0x00,0x00,0x00
-  ,ZEROSx8,ZEROSx16,ZEROSx32,ZEROSx64,ZEROSx128,ZEROSx256,ZEROSx512}},
-  {0,0,{0}}
-};
+/*
+* A frame of the cycle and its response statistics
+*/
+typedef struct _fioFrame {
+  const char      *name;
+  const fioComm_t *cmd;
+  u_int32          ok,ng;
+  float64          latSum,latMin,latMax;  // response latency in seconds
+} fioFrame_t;
+
+static fioFrame_t fioCycle[FIO_FRAMES];
+static size_t     fioCycleN;
+
+static const u_int8 setOutputsOff[]  = {0x00};
+static const u_int8 setOutputsOn[]   = {0xff};
+static const u_int8 cfgTracking[]    = {0x00,0x00,0x00,0x00};
+static const u_int8 cfgInputs[]      = {0x76, // input filter settings for inputs 0x00..0x75
+  FIO_FLT8(0x00u),FIO_FLT8(0x08u),FIO_FLT8(0x10u),FIO_FLT8(0x18u),
+  FIO_FLT8(0x20u),FIO_FLT8(0x28u),FIO_FLT8(0x30u),FIO_FLT8(0x38u),
+  FIO_FLT8(0x40u),FIO_FLT8(0x48u),FIO_FLT8(0x50u),FIO_FLT8(0x58u),
+  FIO_FLT8(0x60u),FIO_FLT8(0x68u),
+  FIO_FLT(0x70u),FIO_FLT(0x71u),FIO_FLT(0x72u),FIO_FLT(0x73u),FIO_FLT(0x74u),FIO_FLT(0x75u)};
+static const u_int8 getTransitions[] = {0x01};
+
+static const fioComm_t getModuleIdCmd       = FIO_CMD0(0x3c,4);             // module ID
+static const fioComm_t getRawInputsCmd      = FIO_CMD0(0x34,FIO_RX_INPUTS); // raw inputs
+static const fioComm_t getFilteredInputsCmd = FIO_CMD0(0x35,FIO_RX_INPUTS); // filtered inputs
+static const fioComm_t setOutputsCmd        = FIO_CMD(0x31,10,setOutputsOff); // outputs, all off
 
-#if 0
-static fioComm_t getFilteredInputsCmd[] = {
-  {3,22,{0x14,0x83,0x35   // command to get filtered inputs
-  ,0x00,0x00,0x00,0x00,0x00
-  ,ZEROSx8,ZEROSx16,ZEROSx32,ZEROSx64,ZEROSx128,ZEROSx256,ZEROSx512}},
-  {0,0,{0}}
+/*
+* Command sequence run by -s: outputs, input configuration, inputs
+*/
+static const fioComm_t fioCommSequence[] = {
+  FIO_CMD0(0x3c,4),                  // module ID
+  FIO_CMD(0x31,10,setOutputsOff),    // outputs, all off
+  FIO_CMD(0x31,10,setOutputsOn),     // outputs, all on
+  FIO_CMD(0x32,4,cfgTracking),       // input tracking
+  FIO_CMD(0x33,4,cfgInputs),         // input filtering
+  FIO_CMD(0x36,22,getTransitions),   // input transitions
+  FIO_CMD0(0x34,FIO_RX_INPUTS),      // raw inputs
+  FIO_CMD0(0x35,FIO_RX_INPUTS),      // filtered inputs
+  FIO_CMD0(0x00,0)
 };
 
-static fioComm_t fioCommSequence[] = {
-{3,4,{0x14,0x83,0x3c //  command to get module ID
-  ,0x00,0x00,0x00,0x00,0x00
-  ,ZEROSx8,ZEROSx16,ZEROSx32,ZEROSx64,ZEROSx128,ZEROSx256,ZEROSx512}},
-
-{4,10,{0x14,0x83,0x31,0x00
-  ,0x00,0x00,0x00,0x00
-  ,ZEROSx8,ZEROSx16,ZEROSx32,ZEROSx64,ZEROSx128,ZEROSx256,ZEROSx512}},
-{4,10,{0x14,0x83,0x31,0xff
-  ,0x00,0x00,0x00,0x00
-  ,ZEROSx8,ZEROSx16,ZEROSx32,ZEROSx64,ZEROSx128,ZEROSx256,ZEROSx512}},
-{7,4,{0x14,0x83,0x32,0x00,0x00,0x00,0x00
-  ,0x00
-  ,ZEROSx8,ZEROSx16,ZEROSx32,ZEROSx64,ZEROSx128,ZEROSx256,ZEROSx512}},
-{358,4,
-{0x14,0x83,0x33,0x76,0x00,0x05,0x05,0x01,0x05,0x05,0x02,0x05,0x05,0x03,0x05,0x05
-,0x04,0x05,0x05,0x05,0x05,0x05,0x06,0x05,0x05,0x07,0x05,0x05,0x08,0x05,0x05,0x09
-,0x05,0x05,0x0a,0x05,0x05,0x0b,0x05,0x05,0x0c,0x05,0x05,0x0d,0x05,0x05,0x0e,0x05
-,0x05,0x0f,0x05,0x05,0x10,0x05,0x05,0x11,0x05,0x05,0x12,0x05,0x05,0x13,0x05,0x05
-,0x14,0x05,0x05,0x15,0x05,0x05,0x16,0x05,0x05,0x17,0x05,0x05,0x18,0x05,0x05,0x19
-,0x05,0x05,0x1a,0x05,0x05,0x1b,0x05,0x05,0x1c,0x05,0x05,0x1d,0x05,0x05,0x1e,0x05
-,0x05,0x1f,0x05,0x05,0x20,0x05,0x05,0x21,0x05,0x05,0x22,0x05,0x05,0x23,0x05,0x05
-,0x24,0x05,0x05,0x25,0x05,0x05,0x26,0x05,0x05,0x27,0x05,0x05,0x28,0x05,0x05,0x29
-,0x05,0x05,0x2a,0x05,0x05,0x2b,0x05,0x05,0x2c,0x05,0x05,0x2d,0x05,0x05,0x2e,0x05
-,0x05,0x2f,0x05,0x05,0x30,0x05,0x05,0x31,0x05,0x05,0x32,0x05,0x05,0x33,0x05,0x05
-,0x34,0x05,0x05,0x35,0x05,0x05,0x36,0x05,0x05,0x37,0x05,0x05,0x38,0x05,0x05,0x39
-,0x05,0x05,0x3a,0x05,0x05,0x3b,0x05,0x05,0x3c,0x05,0x05,0x3d,0x05,0x05,0x3e,0x05
-,0x05,0x3f,0x05,0x05,0x40,0x05,0x05,0x41,0x05,0x05,0x42,0x05,0x05,0x43,0x05,0x05
-,0x44,0x05,0x05,0x45,0x05,0x05,0x46,0x05,0x05,0x47,0x05,0x05,0x48,0x05,0x05,0x49
-,0x05,0x05,0x4a,0x05,0x05,0x4b,0x05,0x05,0x4c,0x05,0x05,0x4d,0x05,0x05,0x4e,0x05
-,0x05,0x4f,0x05,0x05,0x50,0x05,0x05,0x51,0x05,0x05,0x52,0x05,0x05,0x53,0x05,0x05
-,0x54,0x05,0x05,0x55,0x05,0x05,0x56,0x05,0x05,0x57,0x05,0x05,0x58,0x05,0x05,0x59
-,0x05,0x05,0x5a,0x05,0x05,0x5b,0x05,0x05,0x5c,0x05,0x05,0x5d,0x05,0x05,0x5e,0x05
-,0x05,0x5f,0x05,0x05,0x60,0x05,0x05,0x61,0x05,0x05,0x62,0x05,0x05,0x63,0x05,0x05
-,0x64,0x05,0x05,0x65,0x05,0x05,0x66,0x05,0x05,0x67,0x05,0x05,0x68,0x05,0x05,0x69
-,0x05,0x05,0x6a,0x05,0x05,0x6b,0x05,0x05,0x6c,0x05,0x05,0x6d,0x05,0x05,0x6e,0x05
-,0x05,0x6f,0x05,0x05,0x70,0x05,0x05,0x71,0x05,0x05,0x72,0x05,0x05,0x73,0x05,0x05
-,0x74,0x05,0x05,0x75,0x05,0x05}},
-{4,22,{0x14,0x83,0x36,0x01
-  ,0x00,0x00,0x00,0x00
-  ,ZEROSx8,ZEROSx16,ZEROSx32,ZEROSx64,ZEROSx128,ZEROSx256,ZEROSx512}},
-}},
-{3,22,{0x14,0x83,0x34  // raw inputs
-  ,0x00,0x00,0x00,0x00,0x00
-  ,ZEROSx8,ZEROSx16,ZEROSx32,ZEROSx64,ZEROSx128,ZEROSx256,ZEROSx512}},
-{3,22,{0x14,0x83,0x35  // filtered inputs
-  ,0x00,0x00,0x00,0x00,0x00
-  ,ZEROSx8,ZEROSx16,ZEROSx32,ZEROSx64,ZEROSx128,ZEROSx256,ZEROSx512}},
-{0,0,{0}}
-};
-#endif
+/*
+* Reverse video for set bytes and the monitor register
+*/
+static bool mdmpvHilite(size_t idx, u_int8 val)
+{
+  return((val != 0u) || (idx == MONITOR_REG)); // register 14 plus 3 byte header
+}
 
 static void mdmpv(const u_int8 *cp,size_t sz,const char *mp)
 {
-  const u_int8 *tcp;
-  u_int8 zero=0;
-  int32 res;
-  size_t i;
+  if(!fioDump)
+  {
+    return;
+  }
+
   fitPrint(VERBOSE,"\n%s\n",mp);
+  mdmpRows(cp,sz,VERBOSE,"",": ","\n",8u,mdmpvHilite);
+}
+
+/*
+* Response size of a command for the module in use, 0 if it has none
+*/
+static size_t fioRxSize(const fioComm_t *fioCp)
+{
+  size_t sz;
 
-  tcp=cp;
-  for(i=0;i<sz;i++)
+  if(fioCp->rxsz != FIO_RX_INPUTS)
   {
-    if ((i%32u) == 0u)
-    {
-      fitPrint(VERBOSE,"%8.8x: ",i);
-    }
-    else if ((i%16u) == 0u)
-    {
-      fitPrint(VERBOSE," ");
-    }
-    else if ((i%8u) == 0u)
-    {
-      fitPrint(VERBOSE," ");
-    }
-    else
-    {
-      //do nothing
-    }
+    return(fioCp->rxsz);
+  }
 
-    res = memcmp(tcp,&zero,1);
+  switch (modId)
+  {
+    case 1: // 2070-2A/E/E+
+      sz = 15u;
+      break;
+    case 2: // 2070-8/NEMA TS 1 or TS 2-Type 2 (A, B, C and D conn)
+    case 3: // 2070-2N/NEMA TS 2-Type 1
+      sz = 22u;
+      break;
+    default: // input frames unknown
+      sz = 0u;
+      break;
+  }
 
-    if ((res != 0) || (i == MONITOR_REG)) // register 14 plus 3 byte header
-    {
-      fitPrint(VERBOSE,"\x1b" "[7m%2.2x\x1b" "[m",*tcp);
-    }
-    else
-    {
-      fitPrint(VERBOSE,"%2.2x",*tcp);
-    }
+  return(sz);
+}
+
+/*
+* Encode a command into txBuf, returns the frame size
+*/
+static size_t fioBuild(const fioComm_t *fioCp)
+{
+  if((FIO_HDR + fioCp->len) > sizeof(txBuf))
+  {
+    fitPrint(ERROR,"%s: frame type 0x%2.2x too long, %u bytes\n",
+             __func__,fioCp->type,fioCp->len);
+    return(0u);
+  }
 
-    tcp++;
+  txBuf[0] = FIO_ADDR;
+  txBuf[1] = FIO_CTRL;
+  txBuf[2] = fioCp->type;
+  if(fioCp->len != 0u)
+  {
+    memcpy(&txBuf[FIO_HDR],fioCp->data,fioCp->len);
   }
-  fitPrint(VERBOSE,"\n");
+
+  return(FIO_HDR + fioCp->len);
 }
 
-static ftRet_t txFio(const u_int8 *tx_cp,size_t sz,struct timespec *tx_tp)
+static ftRet_t txFio(const fioComm_t *fioCp,struct timespec *tx_tp)
 {
   ssize_t bCnt;
   ftRet_t ftRet = ftPass;
+  const u_int8 *tx_cp = txBuf;
+  size_t  sz = fioBuild(fioCp);
+
+  if(sz == 0u)
+  {
+    return(ftError);
+  }
 
   mdmpv(tx_cp,sz,"Transmit buffer");
 
   /*
   * Transmit
   */
-  (void) clock_gettime(CLOCK_REALTIME, tx_tp);
+  (void) clock_gettime(FIO_CLOCK, tx_tp);
   bCnt = write(sp5s_fd,tx_cp,sz);
   if(bCnt == -1)
   {
@@ -240,9 +256,8 @@ static ftRet_t rxFio(u_int8 *rx_cp,size_t sz, struct timespec *rx_tp)
 
   memset(rx_cp,0,sz); // clear receive buffer
 
-  // receive timeout interval
-  tv.tv_sec = RXTMO;
-  tv.tv_usec = 0;
+  // receive timeout interval, the cycle period when cycling
+  tv = fioRxTmo;
 
 eagain2:
   retval = select(sp5s_fd + 1,&rfds,NULL,NULL,&tv);
@@ -302,7 +317,7 @@ eagain2:
       /*
       * Received a frame, check payload
       */
-      (void) clock_gettime(CLOCK_REALTIME, rx_tp);
+      (void) clock_gettime(FIO_CLOCK, rx_tp);
       mdmpv(rx_cp,sz,"Receive buffer");
 
       return(ftPass);
@@ -316,9 +331,29 @@ eagain2:
 
 static void usage(char * cp)
 {
-  const char *us = "not implemented!";
-
-  fitPrint(USER,  "usage: %s %s\n",cp,us);
+  const char *us = "\n\
+\tReads the FIO module ID and the monitor bits from the raw inputs.\n\
+\t-r then keeps polling the module like the controller application,\n\
+\t   this many cycles per second (10 or 100 for an ATC). Each cycle\n\
+\t   starts at an absolute CLOCK_MONOTONIC deadline and exchanges the\n\
+\t   module ID, outputs, raw and filtered input frames the module\n\
+\t   supports, each response due within the cycle. Response latency\n\
+\t   per frame, release jitter and missed deadlines are reported.\n\
+\t-d cycle for this many seconds, 60 by default\n\
+\t-s run the command sequence (outputs off and on, input tracking and\n\
+\t   filter configuration, input transitions, raw and filtered inputs)\n\
+\t   this many times, before any cycling\n\
+\t-l latency probe, this many thousand raw input (or module ID) frames\n\
+\t   back to back before any cycling. Response times are collected in a\n\
+\t   histogram and reported as percentiles.\n\
+\t-t response deadline in microseconds, slower probe responses fail\n\
+\t-p real time priority, SCHED_RR 1 by default, 0 for none\n\
+\t-m lock the process memory (mlockall) during the probe and cycling\n\
+\t-a run on this CPU only\n\
+\t-h this help\n\
+";
+
+  fitPrint(USER,  "usage: %s [r[hz]d[seconds]s[count]l[thousands]t[usec]p[priority]ma[cpu]h]\n%s\n",cp,us);
   fitLicense();
   exit(-1);
 }
@@ -337,10 +372,10 @@ static ftRet_t runFioCmd(const fioComm_t *fioCp)
   /*
   * Transmit
   */
-  ftRet = txFio(fioCp->txCmd,fioCp->txsz,&tx_t);
+  ftRet = txFio(fioCp,&tx_t);
   if(ftRet != ftPass)
   {
-    fitPrint(ERROR,"%s: cannot transmit %4.4u bytes\n",__func__,fioCp->rxsz);
+    fitPrint(ERROR,"%s: cannot transmit frame type 0x%2.2x\n",__func__,fioCp->type);
   }
   else
   {
@@ -348,10 +383,10 @@ static ftRet_t runFioCmd(const fioComm_t *fioCp)
     /*
     * Receive
     */
-    ftRet = rxFio(rxBuf,fioCp->rxsz,&rx_t);
+    ftRet = rxFio(rxBuf,fioRxSize(fioCp),&rx_t);
     if(ftRet != ftPass)
     {
-      fitPrint(ERROR,"%s: cannot read %4.4u bytes\n",__func__,fioCp->rxsz);
+      fitPrint(ERROR,"%s: cannot read %4.4u bytes\n",__func__,fioRxSize(fioCp));
     }
     else
     {
@@ -364,26 +399,322 @@ static ftRet_t runFioCmd(const fioComm_t *fioCp)
   return(ftRet);
 }
 
-#if 0
 /*
-* Run a sequence of FIO commands
+* Run a sequence of FIO commands, skipping those the module has no
+* response size for
 */
-static ftRet_t runFioSeq(fioComm_t *fioCp)
+static ftRet_t runFioSeq(const fioComm_t *fioCp)
 {
   ftRet_t ftRet = ftPass;
 
-  for(;fioCp->txsz != (size_t)0;fioCp++)
+  for(;fioCp->type != 0u;fioCp++)
   {
+    if(fioRxSize(fioCp) == 0u)
+    {
+      continue;
+    }
+
     if((ftRet = runFioCmd(fioCp)) != ftPass)
     {
-      fitPrint(ERROR,"%s: cannot read %4.4d bytes\n",__func__,fioCp->rxsz);
+      fitPrint(ERROR,"%s: frame type 0x%2.2x failed\n",__func__,fioCp->type);
+      break;
+    }
+  }
+
+  return(ftRet);
+}
+
+static float64 fioSecs(const struct timespec *a,const struct timespec *b)
+{
+  return((float64)(b->tv_sec - a->tv_sec) + ((float64)(b->tv_nsec - a->tv_nsec) * 1.0e-9));
+}
+
+static void fioAddNs(struct timespec *tp,int32 ns)
+{
+  tp->tv_nsec += ns;
+  while(tp->tv_nsec >= 1000000000L)
+  {
+    tp->tv_nsec -= 1000000000L;
+    tp->tv_sec++;
+  }
+}
+
+/*
+* The frames of a cycle, as far as the module supports them
+*/
+static void fioCycleAdd(const char *name,const fioComm_t *cmd)
+{
+  fioFrame_t *fp = &fioCycle[fioCycleN++];
+
+  memset(fp,0,sizeof(*fp));
+  fp->name = name;
+  fp->cmd = cmd;
+  fp->latMin = 1.0e9;
+}
+
+static void fioCycleSet(void)
+{
+  fioCycleN = 0u;
+  fioCycleAdd("module id",&getModuleIdCmd);
+
+  if(fioRxSize(&getRawInputsCmd) != 0u) // else module ID is all we know about
+  {
+    fioCycleAdd("outputs",&setOutputsCmd);
+    fioCycleAdd("raw inputs",&getRawInputsCmd);
+    fioCycleAdd("filtered inputs",&getFilteredInputsCmd);
+  }
+}
+
+/*
+* One frame of the cycle
+*/
+static ftRet_t fioExchange(fioFrame_t *fp)
+{
+  ftRet_t ftRet;
+  struct timespec tx_t;
+  struct timespec rx_t;
+  float64 lat;
+
+  ftRet = txFio(fp->cmd,&tx_t);
+  if(ftRet == ftPass)
+  {
+    ftRet = rxFio(rxBuf,fioRxSize(fp->cmd),&rx_t);
+  }
+
+  if(ftRet != ftPass)
+  {
+    fp->ng++;
+    (void) tcflush(sp5s_fd,TCIFLUSH); // a late response must not answer the next frame
+    return(ftRet);
+  }
+
+  lat = fioSecs(&tx_t,&rx_t);
+  fp->ok++;
+  fp->latSum += lat;
+  fp->latMin = MIN(fp->latMin,lat);
+  fp->latMax = MAX(fp->latMax,lat);
+
+  return(ftPass);
+}
+
+/*
+*
+* Cyclic polling
+*
+* The frames go out every period like the controller application sends
+* them. Cycles are released at absolute deadlines, so a late cycle does not
+* shift the ones after it. A cycle still busy at the next deadline misses
+* it, and the deadlines passed meanwhile are skipped.
+*
+*/
+static ftRet_t fioCyclic(u_int32 hz,u_int32 duration)
+{
+  const int32 periodNs = (int32)(1000000000u / hz);
+  struct timespec start,end,next,now,last;
+  ftRecord_t rec;
+  ftRet_t ftRet = ftPass;
+  ftRet_t frRet;
+  u_int32 cycles = 0u,missed = 0u;
+  float64 late,lateSum = 0.0,lateMin = 1.0e9,lateMax = 0.0;
+  size_t  i;
+  fioFrame_t *fp;
+
+  fioCycleSet();
+  fioDump = false;
+  fioRxTmo.tv_sec = 0;
+  fioRxTmo.tv_usec = periodNs / 1000;
+
+  fitPrint(VERBOSE,"====================\nCycling %u frames at %lu Hz for %lu seconds\n",
+           fioCycleN,hz,duration);
+
+  (void) clock_gettime(CLOCK_MONOTONIC,&start);
+  end = start;
+  end.tv_sec += (time_t)duration;
+  next = start;
+  last = start;
+
+  while(keepGoing)
+  {
+    fioAddNs(&next,periodNs);
+    if(fioSecs(&next,&end) < 0.0)
+    {
       break;
     }
+
+    while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&next,NULL) == EINTR)
+    {
+      ; // a signal, sleep on to the deadline
+    }
+
+    (void) clock_gettime(CLOCK_MONOTONIC,&now);
+    late = fioSecs(&next,&now);
+    lateSum += late;
+    lateMin = MIN(lateMin,late);
+    lateMax = MAX(lateMax,late);
+    cycles++;
+
+    for(i = 0u;i < fioCycleN;i++)
+    {
+      frRet = fioExchange(&fioCycle[i]);
+      ftRet = (ftRet == ftPass) ? frRet : ftRet;
+    }
+
+    (void) clock_gettime(CLOCK_MONOTONIC,&now);
+    while(fioSecs(&next,&now) >= ((float64)periodNs * 1.0e-9))
+    {
+      missed++;
+      fioAddNs(&next,periodNs);
+    }
+
+    if(fioSecs(&last,&now) >= (float64)RXTMO)
+    {
+      fitPrint(VERBOSE,"%s: %lu cycles, %lu deadlines missed, release late by %.0f us at most\n",
+               devName,cycles,missed,lateMax * 1.0e6);
+      last = now;
+    }
+  }
+
+  (void) clock_gettime(CLOCK_MONOTONIC,&now);
+
+  for(i = 0u;i < fioCycleN;i++)
+  {
+    fp = &fioCycle[i];
+    fitPrint(USER,"%s: %-15s ok %lu ng %lu, response min %.0f avg %.0f max %.0f us\n",
+             devName,fp->name,fp->ok,fp->ng,
+             (fp->ok != 0u) ? (fp->latMin * 1.0e6) : 0.0,
+             (fp->ok != 0u) ? ((fp->latSum / (float64)fp->ok) * 1.0e6) : 0.0,
+             fp->latMax * 1.0e6);
+
+    memset(&rec,0,sizeof(rec));
+    rec.event  = fp->name;
+    rec.rx     = devName;
+    rec.tx     = devName;
+    rec.size   = fioRxSize(fp->cmd);
+    rec.result = (fp->ng != 0u) ? ftRxFail : ftPass;
+    rec.okCnt  = fp->ok;
+    rec.ngCnt  = fp->ng;
+    rec.start  = start;
+    rec.end    = now;
+    ftRecord(&rec); // per frame summary, see fit -R
+  }
+
+  fitPrint(USER,"%s: %lu cycles at %lu Hz, %lu deadlines missed, release jitter min %.0f avg %.0f max %.0f us\n",
+           devName,cycles,hz,missed,
+           (cycles != 0u) ? (lateMin * 1.0e6) : 0.0,
+           (cycles != 0u) ? ((lateSum / (float64)cycles) * 1.0e6) : 0.0,
+           lateMax * 1.0e6);
+
+  memset(&rec,0,sizeof(rec));
+  rec.event  = "deadlines";
+  rec.rx     = devName;
+  rec.tx     = devName;
+  rec.result = (missed != 0u) ? ftFail : ftPass;
+  rec.okCnt  = cycles;
+  rec.ngCnt  = missed;
+  rec.start  = start;
+  rec.end    = now;
+  ftRecord(&rec);
+
+  fioDump = true;
+  fioRxTmo.tv_sec = RXTMO;
+  fioRxTmo.tv_usec = 0;
+
+  if((ftRet == ftPass) && (missed != 0u))
+  {
+    ftRet = ftFail;
   }
 
   return(ftRet);
 }
-#endif
+
+/*
+*
+* Latency probe
+*
+* Frames go out back to back, each as soon as the previous response is in.
+* Their response times, transmit to complete response, go to a histogram.
+*
+*/
+static ftRet_t fioProbe(u_int32 frames,u_int32 deadlineUs)
+{
+  const fioComm_t *cmd = (fioRxSize(&getRawInputsCmd) != 0u) ? &getRawInputsCmd : &getModuleIdCmd;
+  static ftHist_t hist;
+  struct timespec start,end;
+  struct timespec tx_t;
+  struct timespec rx_t;
+  struct sched_param param;
+  plint   policy;
+  ftRecord_t rec;
+  ftRet_t ftRet = ftPass;
+  ftRet_t frRet;
+  u_int32 i,usec;
+  u_int32 failed = 0u,late = 0u;
+
+  memset(&hist,0,sizeof(hist));
+  (void) pthread_getschedparam(pthread_self(),&policy,&param);
+
+  fitPrint(VERBOSE,"====================\nLatency probe, %lu frames of type 0x%2.2x\n",
+           frames,cmd->type);
+
+  fioDump = false;
+  (void) clock_gettime(CLOCK_MONOTONIC,&start);
+
+  for(i = 0u;(i < frames) && keepGoing;i++)
+  {
+    frRet = txFio(cmd,&tx_t);
+    if(frRet == ftPass)
+    {
+      frRet = rxFio(rxBuf,fioRxSize(cmd),&rx_t);
+    }
+
+    if(frRet != ftPass)
+    {
+      failed++;
+      ftRet = (ftRet == ftPass) ? frRet : ftRet;
+      (void) tcflush(sp5s_fd,TCIFLUSH); // a late response must not answer the next frame
+      continue;
+    }
+
+    usec = (u_int32)((fioSecs(&tx_t,&rx_t) * 1.0e6) + 0.5);
+    ftHistAdd(&hist,usec);
+    late += ((deadlineUs != 0u) && (usec > deadlineUs)) ? 1u : 0u;
+  }
+
+  (void) clock_gettime(CLOCK_MONOTONIC,&end);
+  fioDump = true;
+
+  fitPrint(USER,"%s: probe %s priority %d, %lu responses, %lu failed, min %lu avg %.0f max %lu us\n",
+           devName,(policy == SCHED_RR) ? "SCHED_RR" : ((policy == SCHED_FIFO) ? "SCHED_FIFO" : "SCHED_OTHER"),
+           param.sched_priority,hist.n,failed,hist.min,
+           (hist.n != 0u) ? (hist.sum / (float64)hist.n) : 0.0,hist.max);
+  fitPrint(USER,"%s: response percentiles p10 %lu p50 %lu p90 %lu p99 %lu p99.9 %lu p99.99 %lu us\n",
+           devName,ftHistPct(&hist,0.1),ftHistPct(&hist,0.5),ftHistPct(&hist,0.9),
+           ftHistPct(&hist,0.99),ftHistPct(&hist,0.999),ftHistPct(&hist,0.9999));
+
+  if(deadlineUs != 0u)
+  {
+    fitPrint(USER,"%s: %lu responses over the %lu us deadline\n",devName,late,deadlineUs);
+  }
+
+  if((ftRet == ftPass) && (late != 0u))
+  {
+    ftRet = ftFail;
+  }
+
+  memset(&rec,0,sizeof(rec));
+  rec.event  = "probe";
+  rec.rx     = devName;
+  rec.tx     = devName;
+  rec.size   = fioRxSize(cmd);
+  rec.result = ftRet;
+  rec.okCnt  = hist.n - late;
+  rec.ngCnt  = failed + late;
+  rec.start  = start;
+  rec.end    = end;
+  ftRecord(&rec); // see fit -R
+
+  return(ftRet);
+}
 
 /*
 * get FIO module ID
@@ -393,11 +724,11 @@ static ftRet_t getModuleId(void)
   ftRet_t ftRet;
 
   fitPrint(VERBOSE,"====================\nGet Module Id\n");
-  ftRet = runFioCmd(getModuleIdCmd);
+  ftRet = runFioCmd(&getModuleIdCmd);
 
   if(ftRet == ftPass)
   {
-    modId = rxBuf[getModuleIdCmd[0].rxsz - 1u];
+    modId = rxBuf[getModuleIdCmd.rxsz - 1u];
 
     switch (modId)
     {
@@ -449,11 +780,11 @@ static ftRet_t getRawInputs(void)
     switch (modId)
     {
       case 1: // 2070-2A/E/E+
-        ftRet = runFioCmd(getRawInputsCmd2);
+        ftRet = runFioCmd(&getRawInputsCmd);
         break;
       case 2: // 2070-8/NEMA TS 1 or TS 2-Type 2 (A, B, C and D conn)
       case 3: // 2070-2N/NEMA TS 2-Type 1
-        ftRet = runFioCmd(getRawInputsCmd8);
+        ftRet = runFioCmd(&getRawInputsCmd);
         break;
       case 4: // NEMA TS 1 or TS 2-Type 2 (A, B, C conn only)
       case 5: // NEMA TS 1 or TS 2-Type 2 (A, B, C and custom conn)
@@ -481,6 +812,18 @@ static ftRet_t getRawInputs(void)
   return(ftRet);
 }
 
+/*
+* Close the port and put the scheduling back as fioMonitorFit() found it,
+* the thread goes on to run other tests
+*/
+static void fioRestore (pthread_t tid, plint policy,
+                        const struct sched_param *param, const cpu_set_t *cpus)
+{
+  (void) pthread_setaffinity_np (tid, sizeof(*cpus), cpus);
+  (void) pthread_setschedparam (tid, policy, param);
+  close(sp5s_fd);
+}
+
 /*
 * Monitor entry
 */
@@ -489,6 +832,16 @@ ftRet_t fioMonitorFit(plint argc, char * const argv[])
   //u_int8 moduleId = 0xff, monitorReg = 0xff;
   int32 idx;
   int32 c;
+  u_int32 hz = 0u;        // -r
+  u_int32 duration = 60u; // -d
+  u_int32 seqs = 0u;      // -s
+  u_int32 probe = 0u;     // -l
+  u_int32 deadlineUs = 0u; // -t
+  int32   prio = 1;       // -p
+  int32   cpu = -1;       // -a
+  bool    lockMem = false; // -m
+  cpu_set_t cpus, old_cpus;
+  u_int32 i;
   ftRet_t ftRet;
   ftResults_t ftResults = {0};
   ftResults_t *ftrp = &ftResults;
@@ -497,7 +850,7 @@ ftRet_t fioMonitorFit(plint argc, char * const argv[])
   plint       old_policy;
   pid_t       kernel_pid;
   pthread_t   pthread_id;
-  struct sched_param proc_param;
+  struct sched_param proc_param, old_param;
 
 
 
@@ -505,24 +858,53 @@ ftRet_t fioMonitorFit(plint argc, char * const argv[])
   * Parse command line arguments
   */
   opterr = 0;
-  c = getopt(argc,argv,"h");
+  c = getopt(argc,argv,"r:d:s:l:t:p:ma:h");
 
   while(c != -1)
   {
-    if ((char)c != 'h')
+    switch ((char)c)
     {
-      if(isprint(optopt))
-      {
-        fitPrint(ERROR, "unknown option `-%c`.\n",optopt);
-      }
-      else
-      {
-        fitPrint(ERROR, "unknown option character `\\x%X`.\n",optopt);
-      }
+      case 'r': // cycles per second
+        hz = MIN(strtoul(optarg,NULL,10),FIO_HZ_MAX);
+        break;
+      case 'd': // seconds of cycling
+        duration = strtoul(optarg,NULL,10);
+        break;
+      case 's': // command sequence runs
+        seqs = strtoul(optarg,NULL,10);
+        break;
+      case 'l': // thousands of probe frames
+        probe = strtoul(optarg,NULL,10) * 1000u;
+        break;
+      case 't': // probe response deadline
+        deadlineUs = strtoul(optarg,NULL,10);
+        break;
+      case 'p': // real time priority
+        prio = strtol(optarg,NULL,10);
+        break;
+      case 'm': // lock memory
+        lockMem = true;
+        break;
+      case 'a': // CPU affinity
+        cpu = strtol(optarg,NULL,10);
+        break;
+      case 'h':
+        usage(argv[0]);
+        break;
+      default:
+        if(isprint(optopt))
+        {
+          fitPrint(ERROR, "unknown option `-%c`.\n",optopt);
+        }
+        else
+        {
+          fitPrint(ERROR, "unknown option character `\\x%X`.\n",optopt);
+        }
+        usage(argv[0]);
+        break;
     }
 
-    usage(argv[0]);
-    c = getopt(argc,argv,"h");
+    c = getopt(argc,argv,"r:d:s:l:t:p:ma:h");
   }
 
   for(idx = optind; idx < argc; idx++)
@@ -531,11 +913,13 @@ ftRet_t fioMonitorFit(plint argc, char * const argv[])
     usage(argv[0]);
   }
 
+  ftArgsDone();
+
   /*
   * Open special device
   */
   //lint -e{9027} MISRA hates bitwise ops on signed values, but can't be helped
-  sp5s_fd = open(devName,O_RDWR|O_NONBLOCK);
+  sp5s_fd = spOpen(devName,O_RDWR|O_NONBLOCK);
 
   if(sp5s_fd == -1)
   {
@@ -546,22 +930,45 @@ ftRet_t fioMonitorFit(plint argc, char * const argv[])
   }
 
   /*
-  * Boost priority to Round Robin 1 for better times
+  * Boost priority to Round Robin (1 by default) for better times, or run
+  * without a boost for comparison
   */
 
   kernel_pid = getpid ();
   pthread_id = pthread_self ();
-  (void) pthread_getschedparam (pthread_id, &old_policy, &proc_param);
-  proc_param.sched_priority = 1;
-  sched_err = pthread_setschedparam (pthread_id, SCHED_RR, &proc_param);
-  fitPrint(VERBOSE,"Set proc %d to Round Robin priority %d, err=%ld\n",
-           kernel_pid, proc_param.sched_priority, sched_err);
+  (void) pthread_getschedparam (pthread_id, &old_policy, &old_param);
+  (void) pthread_getaffinity_np (pthread_id, sizeof(old_cpus), &old_cpus);
+  proc_param = old_param;
+  if (prio > 0)
+  {
+    proc_param.sched_priority = MIN(prio, sched_get_priority_max (SCHED_RR));
+    sched_err = pthread_setschedparam (pthread_id, SCHED_RR, &proc_param);
+    fitPrint(VERBOSE,"Set proc %d to Round Robin priority %d, err=%ld\n",
+             kernel_pid, proc_param.sched_priority, sched_err);
+  }
+  else
+  {
+    proc_param.sched_priority = 0;
+    sched_err = pthread_setschedparam (pthread_id, SCHED_OTHER, &proc_param);
+    fitPrint(VERBOSE,"Set proc %d to normal scheduling, err=%ld\n",
+             kernel_pid, sched_err);
+  }
+
+  if (cpu >= 0)
+  {
+    CPU_ZERO (&cpus);
+    CPU_SET (cpu, &cpus);
+    sched_err = pthread_setaffinity_np (pthread_id, sizeof(cpus), &cpus);
+    fitPrint(VERBOSE,"Set proc %d to CPU %ld, err=%ld\n",
+             kernel_pid, cpu, sched_err);
+  }
   sched_yield();
 
   ftRet = getModuleId();
 
   if(ftRet != ftPass)
   {
+    fioRestore(pthread_id, old_policy, &old_param, &old_cpus);
     ftUpdateTestStatus(ftrp,ftRet,NULL);
     return(ftUpdateTestStatus(ftrp,ftComplete,"getModuleId failed"));
   }
@@ -571,38 +978,47 @@ ftRet_t fioMonitorFit(plint argc, char * const argv[])
 
   if(ftRet != ftPass)
   {
+    fioRestore(pthread_id, old_policy, &old_param, &old_cpus);
     ftUpdateTestStatus(ftrp,ftRet,NULL);
     return(ftUpdateTestStatus(ftrp,ftComplete,"getRawInputs failed"));
   }
 
-#if 0
-  for(fioCp = fioCommSequence;fioCp->txsz != (size_t)0;fioCp++)
+  for(i = 0u;(i < seqs) && keepGoing;i++)
   {
-    memset(rxBuf,0,sizeof(rxBuf)); // clear receive buffer
+    fitPrint(VERBOSE,"====================\nCommand sequence %lu\n",i + 1u);
+    ftRet = runFioSeq(fioCommSequence);
 
-    /*
-    * Transmit
-    */
-    if(txFio(devName,sp5s_fd,fioCp->txCmd,fioCp->txsz) != ftPass)
+    if(ftRet != ftPass)
     {
-      fitPrint(ERROR, "cannot transmit from %s, err %u, fd %d, sz %4.4d, %s\n",
-               devName,errno,sp5s_fd,fioCp->txsz,strerror(errno));
-      break;
+      fioRestore(pthread_id, old_policy, &old_param, &old_cpus);
+      ftUpdateTestStatus(ftrp,ftRet,NULL);
+      return(ftUpdateTestStatus(ftrp,ftComplete,"command sequence failed"));
     }
+  }
 
-    /*
-    * Receive
-    */
-    if(rxFio(devName,sp5s_fd,rxBuf,fioCp->rxsz) != ftPass)
-    {
-      fitPrint(ERROR, "cannot read from %s, err %u, fd %d, sz %4.4d, %s\n",
-               devName,errno,sp5s_fd,fioCp->rxsz,strerror(errno));
-      break;
-    }
+  if(lockMem && (mlockall(MCL_CURRENT | MCL_FUTURE) != 0))
+  {
+    fitPrint(ERROR,"%s: cannot lock memory, err %d, %s\n",
+             __func__,errno,strerror(errno));
+    lockMem = false;
   }
-#endif
 
-  close(sp5s_fd);
+  if(probe != 0u)
+  {
+    ftRet = fioProbe(probe,deadlineUs);
+  }
+
+  if((hz != 0u) && (ftRet == ftPass))
+  {
+    ftRet = fioCyclic(hz,duration);
+  }
+
+  if(lockMem)
+  {
+    (void) munlockall();
+  }
+
+  fioRestore(pthread_id, old_policy, &old_param, &old_cpus);
 
   ftUpdateTestStatus(ftrp,ftRet,NULL);
   return(ftUpdateTestStatus(ftrp,ftComplete,NULL));
@@ -58,6 +58,7 @@ extern size_t strnlen(const char *s, size_t maxlen);
 
 bool   keepGoing = true;
 bool   verboseFlag = false;
+const char *ftPortSpec = NULL; // serial port backend, see serialLib.c
 
 ftArchUnderTest_t targetARCH = ARCH_UNKNOWN;
 
@@ -81,12 +82,45 @@ static bool   logFailureFileFlag = false;
 
 static FILE *ftLogfp = NULL;
 static FILE *ftFailLogfp = NULL;
+static FILE *ftResultfp = NULL;  // structured results, fit -R
 
 static ftResults_t ftResults = {0};
 static ftResults_t *ftrp = &ftResults;
+static volatile sig_atomic_t ftSigIntCnt = 0; // SIGINTs caught, kept out of the slots
+
+static u_int32 ftSlotNext = 0;                   // next shared slot, all are claimed
+static u_int32 ftSlotUsed = 0;                   // claimed result slots, a bit each
+static __thread u_int32 ftSlotIdx = FT_RESULT_SLOTS; // this thread's result slot
+static pthread_key_t  ftSlotKey;                 // releases the slot at thread exit
+static pthread_once_t ftSlotOnce = PTHREAD_ONCE_INIT;
 
 static char ftTestName[MUST_BE_BIG_ENOUGH];
 
+/*
+* State of a thread running a plan entry, see run()
+*/
+static __thread const char *ftThreadName = NULL; // test run by this thread
+static __thread bool ftThreadFailed = false;     // it reported a failure
+static __thread bool ftArgHeld = false;          // it owns getopt()
+static pthread_mutex_t ftArgMutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define FT_NAME() ((ftThreadName != NULL) ? ftThreadName : ftTestName)
+
+/*
+* Identity of the unit under test. Resolved once at start up so that
+* ftUpdateTestStatus() never opens a socket or reads the device tree.
+*/
+#define MAC_ADDR_SZ  18u // "XX:XX:XX:XX:XX:XX" plus terminator
+#define HOST_NAME_SZ 64u
+
+typedef struct {
+  char              macAddr[MAC_ADDR_SZ];
+  char              hostName[HOST_NAME_SZ];
+  ftArchUnderTest_t arch;
+} ftIdentity_t;
+
+static ftIdentity_t ftIdentity = {"MAC ERROR","",ARCH_UNKNOWN};
+
 /* CRC values per RFC 1662 */
 static const u_int16 fcstab[256] =
 {
@@ -231,6 +265,134 @@ static void ftGetMac(char *macaddr)
   return;
 }
 
+/*
+*
+* Resolve the process identity (MAC, hostname, architecture) once.
+*
+*/
+static void ftInitIdentity(void)
+{
+  char macaddr[MUST_BE_BIG_ENOUGH] = {'\0'};
+
+  ftGetMac(macaddr);
+  if (macaddr[0] != '\0')
+  {
+    (void) snprintf(ftIdentity.macAddr, sizeof(ftIdentity.macAddr), "%s", macaddr);
+  }
+
+  if (gethostname(ftIdentity.hostName, sizeof(ftIdentity.hostName) - 1u) != 0)
+  {
+    strcpy(ftIdentity.hostName, "unknown");
+  }
+
+  ftIdentity.arch = getTargetArch();
+}
+
+/*
+*
+* Build the "time stamp: MAC: " prefix of a status log line
+*
+*/
+static void ftLogPrefix(char *lbuf)
+{
+  ftGetTs(lbuf); // get the time stamp
+  strcat(lbuf, ": ");
+  strcat(lbuf, ftIdentity.macAddr); // cached MAC address
+  strcat(lbuf, ": ");
+}
+
+
+/*
+*
+* Slicing-by-8 tables derived from fcstab[]. fcsSlice[k][b] is the FCS
+* contribution of byte b followed by k zero bytes, so eight input bytes
+* fold into the FCS with eight independent lookups.
+*
+*/
+static u_int16 fcsSlice[CRC_SLICES][256];
+static bool fcsSliceOk = false;
+static pthread_once_t fcsSliceOnce = PTHREAD_ONCE_INIT;
+
+static u_int16 crcBytewise(u_int16 fcs, const u_int8 *cp, size_t len)
+{
+  for(;len != 0u;len--)
+  {
+    fcs = (fcs >> 8u) ^ fcstab[(fcs ^ *cp) & 0xffu];
+    cp++;
+  }
+  return(fcs);
+}
+
+static u_int16 crcSliced(u_int16 fcs, const u_int8 *cp, size_t len)
+{
+  for(;len >= CRC_SLICES;len -= CRC_SLICES)
+  {
+    fcs = fcsSlice[7][(cp[0] ^ fcs) & 0xffu] ^
+          fcsSlice[6][(cp[1] ^ (fcs >> 8u)) & 0xffu] ^
+          fcsSlice[5][cp[2]] ^ fcsSlice[4][cp[3]] ^
+          fcsSlice[3][cp[4]] ^ fcsSlice[2][cp[5]] ^
+          fcsSlice[1][cp[6]] ^ fcsSlice[0][cp[7]];
+    cp = &cp[CRC_SLICES];
+  }
+  return(crcBytewise(fcs, cp, len)); // remaining tail
+}
+
+static void crcSliceInit(void)
+{
+  u_int32 b,k;
+  u_int8  chk[61]; // odd size exercises the bytewise tail
+  u_int16 t;
+
+  for(b=0u;b<256u;b++)
+  {
+    fcsSlice[0][b] = fcstab[b];
+  }
+
+  for(k=1u;k<CRC_SLICES;k++)
+  {
+    for(b=0u;b<256u;b++)
+    {
+      t = fcsSlice[k-1u][b];
+      fcsSlice[k][b] = (t >> 8u) ^ fcstab[t & 0xffu];
+    }
+  }
+
+  /*
+  * Both paths must agree before the sliced one is trusted.
+  */
+  for(b=0u;b<sizeof(chk);b++)
+  {
+    chk[b] = (u_int8)((b * 37u) + 11u);
+  }
+
+  fcsSliceOk = (crcSliced(CRC_INIT, chk, sizeof(chk)) ==
+                crcBytewise(CRC_INIT, chk, sizeof(chk)));
+
+  if (!fcsSliceOk)
+  {
+    fitPrint(ERROR, "%s: sliced CRC mismatch, using bytewise CRC\n",__func__);
+  }
+}
+
+/*
+*
+* Continue a CRC over len more bytes. Start with CRC_INIT; the value
+* returned may be fed back in to CRC data as it is streamed.
+* Per HDLC 16-bit FCS Computation in RFC 1662 C.2
+*
+*/
+
+u_int16 genCrcUpdate(u_int16 fcs, const void *buf, size_t len)
+{
+  (void) pthread_once(&fcsSliceOnce, crcSliceInit);
+
+  if (fcsSliceOk)
+  {
+    return(crcSliced(fcs, buf, len));
+  }
+
+  return(crcBytewise(fcs, buf, len));
+}
 
 /*
 *
@@ -242,66 +404,280 @@ static void ftGetMac(char *macaddr)
 
 u_int16 genCrc(const void *saddr,const void *eaddr)
 {
-  const u_int8  *cp;
-  u_int16  fcs = 0xffffu;
+  const u_int8 *scp = saddr;
+  const u_int8 *ecp = eaddr;
 
-  for(cp=saddr;cp < (const u_int8*)eaddr;cp++)
+  if (ecp <= scp)
   {
-    fcs = (fcs >> 8u) ^ fcstab[(fcs ^ *cp) & 0xffu];
+    return(CRC_INIT);
   }
-  return(fcs);
+
+  return(genCrcUpdate(CRC_INIT, scp, (size_t)(ecp - scp)));
 }
 
 /*
 *
-* Memory dump
+* Log bucketed histogram
+*
+* Values below 2^HIST_SUB_BITS have a bucket each, above that every power
+* of two is split into 2^HIST_SUB_BITS buckets, so any recorded value is
+* known to within 12.5% while a histogram stays under 1 KB.
 *
 */
 
-void mdmp(const void *vp, size_t sz, ftPrintLevels_t printLevel)
+static u_int32 ftHistIdx(u_int32 val, u_int32 sub)
+{
+  u_int32 msb,shift;
+
+  if (val < (1u << sub))
+  {
+    return(val);
+  }
+
+  msb = 31u - (u_int32)__builtin_clz((unsigned int)val);
+  shift = msb - sub;
+
+  return(((shift + 1u) << sub) + ((val >> shift) & ((1u << sub) - 1u)));
+}
+
+/*
+* Highest value that falls in bucket idx
+*/
+static u_int32 ftHistTop(u_int32 idx, u_int32 sub)
+{
+  u_int32 shift;
+
+  if (idx < (1u << sub))
+  {
+    return(idx);
+  }
+
+  shift = (idx >> sub) - 1u;
+
+  return((((idx & ((1u << sub) - 1u)) + (1u << sub)) << shift) +
+         ((1u << shift) - 1u));
+}
+
+void ftHistAdd(ftHist_t *hp, u_int32 val)
+{
+  hp->cnt[ftHistIdx(val,HIST_SUB_BITS)]++;
+
+  if ((hp->n == 0u) || (val < hp->min))
+  {
+    hp->min = val;
+  }
+  if (val > hp->max)
+  {
+    hp->max = val;
+  }
+
+  hp->n++;
+  hp->sum += (float64)val;
+}
+
+void ftHistMerge(ftHist_t *dst, const ftHist_t *src)
+{
+  u_int32 i;
+
+  if (src->n == 0u)
+  {
+    return;
+  }
+
+  for (i=0u;i<HIST_BUCKETS;i++)
+  {
+    dst->cnt[i] += src->cnt[i];
+  }
+
+  if ((dst->n == 0u) || (src->min < dst->min))
+  {
+    dst->min = src->min;
+  }
+  if (src->max > dst->max)
+  {
+    dst->max = src->max;
+  }
+
+  dst->n += src->n;
+  dst->sum += src->sum;
+}
+
+/*
+*
+* Value at or below which pct (0.0 to 1.0) of the samples fall
+*
+*/
+u_int32 ftHistPct(const ftHist_t *hp, float64 pct)
 {
-  size_t i;
-  const u_int8 *ucp;
+  u_int32 i;
+  u_int32 seen = 0u;
+  u_int32 want;
+
+  if (hp->n == 0u)
+  {
+    return(0u);
+  }
 
-  ucp = vp;
+  want = (u_int32)((pct * (float64)hp->n) + 0.999999);
+  want = MAX(want,1u);
 
-  for(i=0u;i<sz;i++){
-    if ((i%32u) == 0u) {
-      fitPrint(printLevel, "\n%8.8x:",i);
+  for (i=0u;i<HIST_BUCKETS;i++)
+  {
+    seen += hp->cnt[i];
+    if (seen >= want)
+    {
+      return(MIN(ftHistTop(i,HIST_SUB_BITS),hp->max));
     }
-    if((i%16u) == 0u){
-      fitPrint(printLevel, " ");
+  }
+
+  return(hp->max);
+}
+
+/*
+*
+* Compact histogram
+*
+* Half the buckets of ftHist_t and 16 bit counts, a value is known to
+* within 25% in a quarter of the space. A count about to wrap halves all
+* of them, the percentiles then come from the shape rather than n.
+*
+*/
+void ftHistCAdd(ftHistC_t *hp, u_int32 val)
+{
+  u_int32 idx = ftHistIdx(val,HISTC_SUB_BITS);
+  u_int32 i;
+
+  if (hp->cnt[idx] == 0xFFFFu)
+  {
+    for (i=0u;i<HISTC_BUCKETS;i++)
+    {
+      hp->cnt[i] = (u_int16)((hp->cnt[i] + 1u) >> 1); // a bucket seen stays seen
     }
-    fitPrint(printLevel, "%2.2x",*ucp++);
   }
 
-  fitPrint(printLevel, "\n");
+  hp->cnt[idx]++;
+
+  if (val > hp->max)
+  {
+    hp->max = val;
+  }
+
+  hp->n++;
+  hp->sum += (float64)val;
 }
 
-void mdmp1(const void *vp, size_t sz, ftPrintLevels_t printLevel,
-           const char *fp, const char *fn, int32 ln, const char *us)
+u_int32 ftHistCPct(const ftHistC_t *hp, float64 pct)
 {
-  size_t i;
-  const u_int8 *ucp;
+  u_int32 i;
+  u_int32 seen = 0u;
+  u_int32 total = 0u;
+  u_int32 want;
 
-  ucp = vp;
-  fitPrint(printLevel,"\nLine %lu of File %s: %s\n%s\n",ln,fp,fn,us);
+  for (i=0u;i<HISTC_BUCKETS;i++)
+  {
+    total += hp->cnt[i];
+  }
+
+  if (total == 0u)
+  {
+    return(0u);
+  }
 
-  for(i=0;i<sz;i++){
-    if ((i%32u) == 0u) {
-      fitPrint(printLevel, "\n%8.8x:",i);
+  want = (u_int32)((pct * (float64)total) + 0.999999);
+  want = MAX(want,1u);
+
+  for (i=0u;i<HISTC_BUCKETS;i++)
+  {
+    seen += hp->cnt[i];
+    if (seen >= want)
+    {
+      return(MIN(ftHistTop(i,HISTC_SUB_BITS),hp->max));
     }
-    else if((i%4u) == 0u){
-      fitPrint(printLevel, " ");
+  }
+
+  return(hp->max);
+}
+
+/*
+*
+* Memory dump
+*
+* Rows of HEX_ROW_BYTES are formatted into a stack buffer from a digit
+* lookup table and handed to fitPrint() once per row. Each row is
+* <pre><offset><sep><bytes><post>, with a space between every grp bytes.
+* Bytes selected by the optional hilite() are shown in reverse video.
+*
+*/
+
+static const char hexDigits[] = "0123456789abcdef";
+
+void mdmpRows(const void *vp, size_t sz, ftPrintLevels_t printLevel,
+              const char *pre, const char *sep, const char *post,
+              size_t grp, mdmpHilite_t hilite)
+{
+  char   row[MUST_BE_BIG_ENOUGH];
+  char  *rp;
+  size_t i,j,n,sh;
+  const u_int8 *ucp = vp;
+
+  if ((printLevel == VERBOSE) && !verboseFlag)
+  {
+    return; // nothing would be printed
+  }
+
+  for(i=0u;i<sz;i+=HEX_ROW_BYTES)
+  {
+    n = MIN(sz - i, HEX_ROW_BYTES);
+
+    rp = row;
+    rp = stpcpy(rp, pre);
+    for(sh=28u;;sh-=4u) // eight digit offset
+    {
+      *rp++ = hexDigits[(i >> sh) & 0xfu];
+      if (sh == 0u)
+      {
+        break;
+      }
     }
-    else
+    rp = stpcpy(rp, sep);
+
+    for(j=0u;j<n;j++)
     {
-      // don't print anything
+      if ((j != 0u) && ((j % grp) == 0u))
+      {
+        *rp++ = ' ';
+      }
+
+      if ((hilite != NULL) && hilite(i + j, ucp[i + j]))
+      {
+        rp = stpcpy(rp, "\x1b" "[7m");
+        *rp++ = hexDigits[ucp[i + j] >> 4u];
+        *rp++ = hexDigits[ucp[i + j] & 0xfu];
+        rp = stpcpy(rp, "\x1b" "[m");
+      }
+      else
+      {
+        *rp++ = hexDigits[ucp[i + j] >> 4u];
+        *rp++ = hexDigits[ucp[i + j] & 0xfu];
+      }
     }
 
-    fitPrint(printLevel, "%2.2x",*ucp++);
+    (void) stpcpy(rp, post);
+    fitPrint(printLevel, "%s", row);
   }
+}
+
+void mdmp(const void *vp, size_t sz, ftPrintLevels_t printLevel)
+{
+  mdmpRows(vp, sz, printLevel, "\n", ": ", "", 16u, NULL);
+  fitPrint(printLevel, "\n");
+}
 
+void mdmp1(const void *vp, size_t sz, ftPrintLevels_t printLevel,
+           const char *fp, const char *fn, int32 ln, const char *us)
+{
+  fitPrint(printLevel,"\nLine %lu of File %s: %s\n%s\n",ln,fp,fn,us);
+  mdmpRows(vp, sz, printLevel, "\n", ":", "", 4u, NULL);
   fitPrint(printLevel, "\n");
 }
 
@@ -564,74 +940,655 @@ static ftRet_t tod(plint argc,char * const argv[])
 typedef struct _ft {
   const char *ftName;
   ftRet_t (*ftfp)(plint argc,char * const argv[]);
+  bool        ftOpts; // parses its options with getopt()
 } ft;
 
+static ftRet_t run(plint argc,char * const argv[]);
+
 
 static const ft ftTest[] = {
-  { "datakey",datakey },
-  { "display",display },
-  { "eeprom",eeprom },
-  { "ethernet",ethernet },
-  { "fio_monitor",fioMonitor },
-  { "filesystem",fs },
-  { "sd",sd },
-  { "usb",usb },
-  { "memory",memory },
-  { "powerdown",powerdown },
-  { "rtc",rtc },
-  { "serial",serial },
-  { "serial_echo",serial_echo },
-  { "serial_port",serial_port },
+  { "datakey",datakey,false },
+  { "display",display,true },
+  { "eeprom",eeprom,true },
+  { "ethernet",ethernet,true },
+  { "fio_monitor",fioMonitor,true },
+  { "filesystem",fs,false },
+  { "sd",sd,false },
+  { "usb",usb,false },
+  { "memory",memory,true },
+  { "powerdown",powerdown,false },
+  { "rtc",rtc,false },
+  { "run",run,false },
+  { "serial",serial,true },
+  { "serial_echo",serial_echo,true },
+  { "serial_port",serial_port,true },
 #if 0
-  { "serial_route",spRoute },
-  { "tod",tod },
+  { "serial_route",spRoute,true },
+  { "tod",tod,true },
 #endif
-  { "",NULL }
+  { "",NULL,false }
 };
 
 /*
 *
-* Helper print function for ftUpdateTestStatus().
+* Asynchronous log sink
+*
+* LOG and LOG_FAILURE records are formatted by the calling thread into a
+* bounded ring and written out by a single logger thread. Producers claim
+* a ring slot with a compare and swap, so a test thread never waits on
+* the file system. The logger drains whatever has been queued, flushes
+* stdio once per batch and fsync()s at most once per sync interval. A
+* full ring throttles the producers rather than dropping records.
 *
 */
-static void printCountIfNonzero(u_int32 cnt, const char *name, char *tbuf,
-                                char *lbuf, int32 *pfCnt)
+#define LOG_RING_SLOTS  64u  // must be a power of 2
+#define LOG_REC_SZ      (MUST_BE_BIG_ENOUGH * 2u)
+#define LOG_SYNC_MS     1000 // default group commit interval
+
+typedef struct {
+  volatile u_int32 seq;   // ring sequence, see ftLogPut()/ftLogDrain()
+  ftPrintLevels_t  level; // LOG or LOG_FAILURE
+  size_t           len;
+  char             text[LOG_REC_SZ];
+} ftLogRec_t;
+
+static ftLogRec_t       logRing[LOG_RING_SLOTS];
+static volatile u_int32 logHead = 0;  // next slot to claim, producers
+static u_int32          logTail = 0;  // next slot to write, logger only
+static u_int32          logSynced = 0; // records written and synced
+static u_int32          logWaiters = 0; // threads blocked in ftLogFlush()
+static volatile bool    logRun = false;
+static bool             logAsync = false;
+static int32            logSyncMs = LOG_SYNC_MS;
+static sem_t            logSem;
+static pthread_t        logThread;
+static pthread_mutex_t  logMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   logCond = PTHREAD_COND_INITIALIZER;
+
+/*
+*
+* Queue one preformatted record, called from fitPrint()
+*
+*/
+static void ftLogPut(ftPrintLevels_t printLevel, const char *format, va_list args)
 {
-  if(cnt != 0u)
+  ftLogRec_t *rp;
+  u_int32 pos = logHead;
+  int32   dif;
+  int     len;
+
+  for(;;)
   {
-    sprintf(tbuf,"                         %-9s %4.4lu\n",name,cnt);
-    strcat(lbuf,tbuf);
-    (*pfCnt)++;
+    rp = &logRing[pos & (LOG_RING_SLOTS - 1u)];
+    dif = (int32)(rp->seq - pos);
+
+    if (dif == 0)
+    {
+      if (__sync_bool_compare_and_swap(&logHead, pos, pos + 1u))
+      {
+        break; // slot is ours
+      }
+    }
+    else if (dif < 0)
+    {
+      (void) sem_post(&logSem); // ring is full, let the logger catch up
+      (void) sched_yield();
+    }
+    else
+    {
+      // another producer got here first
+    }
+    pos = logHead;
+  }
+
+  len = vsnprintf(rp->text, sizeof(rp->text), format, args);
+  if (len < 0)
+  {
+    len = 0;
   }
+  rp->len = ((size_t)len < sizeof(rp->text)) ? (size_t)len : sizeof(rp->text) - 1u;
+  rp->level = printLevel;
+
+  __sync_synchronize(); // publish the record before the sequence
+  rp->seq = pos + 1u;
+
+  (void) sem_post(&logSem);
 }
 
 /*
 *
-* Updates the status of the overall test.
-* This function always returns the value passed in for "ret"
+* File written for a logged print level, NULL if that log is not open
 *
 */
-ftRet_t ftUpdateTestStatus(ftResults_t *ftres, ftRet_t ret, const char *descr)
+static FILE *ftLogFileOf(ftPrintLevels_t level)
 {
-  char lbuf[MUST_BE_BIG_ENOUGH],tbuf[MUST_BE_BIG_ENOUGH];
-  int32 i;
-  int32 passCnt=0;
-  int32 failCnt=0;
-  bool  getOut = false;
-  bool  testFailed = false;
+  FILE *fp;
 
-  lbuf[0] = '\0'; tbuf[0] = '\0';
-
-  ftGetTs(lbuf); // get the time stamp
-  strcat(lbuf, ": ");
-  ftGetMac(tbuf); // get the MAC address
-  strcat(lbuf, tbuf);
-  strcat(lbuf, ": ");
+  switch (level)
+  {
+    case LOG:
+      fp = ftLogfp;
+      break;
+    case LOG_FAILURE:
+      fp = ftFailLogfp;
+      break;
+    case RESULT:
+      fp = ftResultfp;
+      break;
+    default:
+      fp = NULL;
+      break;
+  }
+
+  return(fp);
+}
+
+/*
+*
+* Write out everything queued so far, returns the number of records.
+* The levels written to are added to the dirty mask.
+*
+*/
+static u_int32 ftLogDrain(u_int32 *dirty)
+{
+  ftLogRec_t *rp;
+  FILE    *fp;
+  u_int32 cnt = 0u;
+
+  for(;;)
+  {
+    rp = &logRing[logTail & (LOG_RING_SLOTS - 1u)];
+    if ((int32)(rp->seq - (logTail + 1u)) < 0)
+    {
+      break; // empty
+    }
+
+    __sync_synchronize();
+
+    fp = ftLogFileOf(rp->level);
+    if (fp != NULL)
+    {
+      (void) fwrite(rp->text, 1u, rp->len, fp);
+      *dirty |= (1u << (u_int32)rp->level);
+    }
+
+    __sync_synchronize();
+    rp->seq = logTail + LOG_RING_SLOTS; // hand the slot back
+    logTail++;
+    cnt++;
+  }
+
+  return(cnt);
+}
+
+/*
+*
+* fflush() or fsync() every log in the dirty mask
+*
+*/
+static void ftLogCommit(u_int32 dirty, bool toMedia)
+{
+  ftPrintLevels_t level;
+  FILE *fp;
+
+  for (level = LOG_FAILURE; level <= RESULT; level++)
+  {
+    fp = ftLogFileOf(level);
+    if (((dirty & (1u << (u_int32)level)) != 0u) && (fp != NULL))
+    {
+      if (toMedia)
+      {
+        (void) fsync(fileno(fp));
+      }
+      else
+      {
+        (void) fflush(fp);
+      }
+    }
+  }
+}
+
+/*
+*
+* Logger thread, group commits the queued records
+*
+*/
+static void *ftLogThread(void *arg)
+{
+  struct timespec now, tmo, lastSync;
+  u_int32 dirty = 0u; // levels written but not yet synced
+  bool   running = true;
+  bool   syncNow;
+  int32  elapsedMs;
+  u_int32 cnt, done = 0u;
+
+  (void) arg;
+  clock_gettime(CLOCK_MONOTONIC, &lastSync);
+
+  while (running)
+  {
+    clock_gettime(CLOCK_REALTIME, &tmo);
+    tmo.tv_sec += (logSyncMs > 0) ? (logSyncMs / 1000) : 1;
+    tmo.tv_nsec += (logSyncMs > 0) ? ((logSyncMs % 1000) * 1000000) : 0;
+    if (tmo.tv_nsec >= 1000000000)
+    {
+      tmo.tv_sec++;
+      tmo.tv_nsec -= 1000000000;
+    }
+    (void) sem_timedwait(&logSem, &tmo);
+
+    running = logRun;
+    cnt = ftLogDrain(&dirty);
+    ftLogCommit(dirty, false);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsedMs = ((int32)(now.tv_sec - lastSync.tv_sec) * 1000) +
+                (int32)((now.tv_nsec - lastSync.tv_nsec) / 1000000);
+
+    pthread_mutex_lock(&logMutex);
+    syncNow = (logWaiters != 0u);
+    pthread_mutex_unlock(&logMutex);
+
+    if (syncNow || !running || (elapsedMs >= logSyncMs))
+    {
+      ftLogCommit(dirty, true);
+      dirty = 0u;
+    }
+
+    done += cnt;
+    if (dirty == 0u)
+    {
+      lastSync = now; // nothing pending, restart the commit window
+
+      pthread_mutex_lock(&logMutex);
+      logSynced = done;
+      pthread_cond_broadcast(&logCond);
+      pthread_mutex_unlock(&logMutex);
+    }
+  }
+
+  return(NULL);
+}
+
+/*
+*
+* Wait until every record queued so far has been written and synced.
+* Used at test completion and shutdown.
+*
+*/
+static void ftLogFlush(void)
+{
+  u_int32 target;
+
+  if (!logAsync)
+  {
+    return;
+  }
+
+  target = logHead;
+
+  pthread_mutex_lock(&logMutex);
+  logWaiters++;
+  (void) sem_post(&logSem);
+  while ((int32)(logSynced - target) < 0)
+  {
+    pthread_cond_wait(&logCond, &logMutex);
+  }
+  logWaiters--;
+  pthread_mutex_unlock(&logMutex);
+}
+
+/*
+*
+* Open the failure log and start the logger thread. Logging stays
+* synchronous if the thread cannot be started.
+*
+*/
+static void ftLogStart(void)
+{
+  u_int32 i;
+
+  for(i=0u;i<LOG_RING_SLOTS;i++)
+  {
+    logRing[i].seq = i;
+  }
+  logHead = 0u;
+  logTail = 0u;
+  logSynced = 0u;
+
+  if (sem_init(&logSem, 0, 0) != 0)
+  {
+    return;
+  }
+
+  logRun = true;
+  if (pthread_create(&logThread, NULL, ftLogThread, NULL) != 0)
+  {
+    logRun = false;
+    (void) sem_destroy(&logSem);
+    fitPrint(ERROR, "Cannot start logger thread, logging synchronously\n");
+    return;
+  }
+
+  if (logFailureFileFlag)
+  {
+    ftFailLogfp = fopen(failLogFilename, "a"); // kept open until ftLogStop()
+    if (ftFailLogfp == NULL)
+    {
+      fitPrint(ERROR, "Cannot open logfile %s, err %d, %s\n",
+               failLogFilename, errno, strerror(errno));
+    }
+  }
+
+  logAsync = true;
+}
+
+/*
+*
+* Drain the ring, stop the logger thread and close the failure log
+*
+*/
+static void ftLogStop(void)
+{
+  if (logAsync)
+  {
+    ftLogFlush();
+    logRun = false;
+    (void) sem_post(&logSem);
+    (void) pthread_join(logThread, NULL);
+    (void) sem_destroy(&logSem);
+    logAsync = false;
+  }
+
+  if (ftFailLogfp != NULL)
+  {
+    fclose(ftFailLogfp);
+    ftFailLogfp = NULL;
+  }
+}
+
+/*
+*
+* Structured results
+*
+* With fit -R file every ftRecord() and every ftComplete is appended to
+* file as one JSON object per line, for tools that would otherwise have
+* to scrape the upper cased log text. Records go through the log ring so
+* a receiver thread only pays for the formatting.
+*
+*/
+static const char * const ftRetName[] = {
+  "start", "complete", "pass", "fail", "error", "signal",
+  "txtimeout", "txerror", "txfail", "rxerror", "rxtimeout", "rxfail",
+  "newline", "information", "unimplemented", "interrupt"
+};
+
+#define REC_NS(ts) (((unsigned long long)(ts).tv_sec * 1000000000ull) + \
+                    (unsigned long long)(ts).tv_nsec)
+
+bool ftRecording(void)
+{
+  return(ftResultfp != NULL);
+}
+
+/*
+*
+* Copy src to dst as a JSON string body, dropping what would need escapes
+*
+*/
+static void ftRecordStr(char *dst, const char *src, size_t sz)
+{
+  size_t i = 0u;
+
+  for(; (*src != '\0') && (i < (sz - 1u)); src++)
+  {
+    if((*src != '"') && (*src != '\\') && (isprint((int32)*src) != 0))
+    {
+      dst[i] = *src;
+      i++;
+    }
+  }
+  dst[i] = '\0';
+}
+
+/*
+* Append to a record line, false once it no longer fits
+*/
+static bool ftRecordAdd(char *buf, size_t sz, size_t *used, const char *format, ...)
+{
+  va_list args;
+  plint   len;
+
+  va_start(args, format);
+  len = vsnprintf(&buf[*used], sz - *used, format, args);
+  va_end(args);
+
+  if ((len < 0) || ((size_t)len >= (sz - *used)))
+  {
+    return(false);
+  }
+
+  *used += (size_t)len;
+  return(true);
+}
+
+void ftRecord(const ftRecord_t *rp)
+{
+  char   lbuf[MUST_BE_BIG_ENOUGH];
+  size_t used = 0u;
+  bool   ok;
+
+  if(ftResultfp == NULL)
+  {
+    return;
+  }
+
+  ok = ftRecordAdd(lbuf,sizeof(lbuf),&used,"{\"host\":\"%s\",\"test\":\"%s\",\"event\":\"%s\"",
+                   ftIdentity.hostName,(rp->test != NULL) ? rp->test : FT_NAME(),
+                   (rp->event != NULL) ? rp->event : "frame");
+
+  if(ok && (rp->rx != NULL))
+  {
+    ok = ftRecordAdd(lbuf,sizeof(lbuf),&used,",\"rx\":\"%s\"",rp->rx);
+  }
+  if(ok && (rp->tx != NULL))
+  {
+    ok = ftRecordAdd(lbuf,sizeof(lbuf),&used,",\"tx\":\"%s\"",rp->tx);
+  }
+  if(ok && (rp->baud != 0u))
+  {
+    ok = ftRecordAdd(lbuf,sizeof(lbuf),&used,",\"baud\":%lu",rp->baud);
+  }
+  if(ok && (rp->size != 0u))
+  {
+    ok = ftRecordAdd(lbuf,sizeof(lbuf),&used,",\"size\":%lu",(u_int32)rp->size);
+  }
+
+  ok = ok && ftRecordAdd(lbuf,sizeof(lbuf),&used,",\"result\":\"%s\"",ftRetName[rp->result]);
+
+  if(ok && ((rp->okCnt != 0u) || (rp->ngCnt != 0u)))
+  {
+    ok = ftRecordAdd(lbuf,sizeof(lbuf),&used,",\"ok\":%lu,\"ng\":%lu",rp->okCnt,rp->ngCnt);
+  }
+  if(ok && ((rp->start.tv_sec != 0) || (rp->start.tv_nsec != 0)))
+  {
+    ok = ftRecordAdd(lbuf,sizeof(lbuf),&used,",\"start_ns\":%llu,\"end_ns\":%llu",
+                     REC_NS(rp->start),REC_NS(rp->end));
+  }
+
+  if(!ok)
+  {
+    fitPrint(ERROR,"%s: record of %s too long, dropped\n",__func__,
+             (rp->event != NULL) ? rp->event : "frame");
+    return;
+  }
+
+  fitPrint(RESULT,"%s}\n",lbuf);
+}
+
+/*
+*
+* Record written for every ftComplete
+*
+*/
+static void ftRecordComplete(const ftCounts_t *tot, bool testFailed,
+                             bool interrupted, const char *descr)
+{
+  char dbuf[MUST_BE_BIG_ENOUGH / 2u];
+
+  if(ftResultfp == NULL)
+  {
+    return;
+  }
+
+  ftRecordStr(dbuf,(descr != NULL) ? descr : "",sizeof(dbuf));
+
+  fitPrint(RESULT,"{\"host\":\"%s\",\"test\":\"%s\",\"event\":\"complete\"," \
+           "\"result\":\"%s\",\"descr\":\"%s\",\"pass\":%lu,\"fail\":%lu," \
+           "\"error\":%lu,\"signal\":%lu,\"txerror\":%lu,\"txfail\":%lu," \
+           "\"rxerror\":%lu,\"rxtimeout\":%lu,\"rxfail\":%lu,\"interrupted\":%s}\n",
+           ftIdentity.hostName,FT_NAME(),testFailed ? "fail" : "pass",dbuf,
+           tot->ftPassCnt,tot->ftFailCnt,tot->ftErrorCnt,tot->ftSignalCnt,
+           tot->ftTxErrorCnt,tot->ftTxFailCnt,tot->ftRxErrorCnt,
+           tot->ftRxTimeoutCnt,tot->ftRxFailCnt,interrupted ? "true" : "false");
+}
+
+static void ftSlotRelease(void *vp)
+{
+  const u_int32 idx = (u_int32)(size_t)vp - 1u;
+
+  (void) __sync_fetch_and_and(&ftSlotUsed, ~(1uL << idx));
+}
+
+static void ftSlotInit(void)
+{
+  (void) pthread_key_create(&ftSlotKey, ftSlotRelease);
+}
+
+/*
+*
+* Result slot of the calling thread. A thread claims a free slot the first
+* time it reports a result and gives it back when it exits, its counts stay
+* in the slot for the totals. Only when every slot is claimed do threads
+* share them round robin.
+*
+*/
+static ftCounts_t *ftSlot(ftResults_t *ftres)
+{
+  u_int32 i,used;
+
+  if (ftSlotIdx >= FT_RESULT_SLOTS)
+  {
+    (void) pthread_once(&ftSlotOnce, ftSlotInit);
+
+    for (i=0u;(i<FT_RESULT_SLOTS) && (ftSlotIdx >= FT_RESULT_SLOTS);i++)
+    {
+      used = ftSlotUsed;
+      while ((used & (1uL << i)) == 0u)
+      {
+        if (__sync_bool_compare_and_swap(&ftSlotUsed, used, used | (1uL << i)))
+        {
+          ftSlotIdx = i;
+          (void) pthread_setspecific(ftSlotKey, (void *)(size_t)(i + 1u));
+          break;
+        }
+        used = ftSlotUsed;
+      }
+    }
+
+    if (ftSlotIdx >= FT_RESULT_SLOTS)
+    {
+      ftSlotIdx = __sync_fetch_and_add(&ftSlotNext, 1u) % FT_RESULT_SLOTS;
+    }
+  }
+
+  return(&ftres->slot[ftSlotIdx].cnt);
+}
+
+/*
+*
+* Bump a result counter. The slot is normally private to the thread,
+* the atomic only matters when more threads than slots are reporting.
+*
+*/
+static void ftCountBump(u_int32 *cnt)
+{
+  (void) __sync_fetch_and_add(cnt, 1u);
+}
+
+/*
+*
+* Merge all result slots into a single set of totals
+*
+*/
+void ftSumResults(const ftResults_t *ftres, ftCounts_t *tot)
+{
+  u_int32 i,j;
+  const u_int32 *sp;
+  u_int32 *tp = (u_int32 *)tot;
+
+  memset(tot, 0, sizeof(ftCounts_t));
+
+  for(i=0u;i<FT_RESULT_SLOTS;i++)
+  {
+    sp = (const u_int32 *)&ftres->slot[i].cnt;
+    for(j=0u;j<(sizeof(ftCounts_t)/sizeof(u_int32));j++)
+    {
+      tp[j] += __sync_fetch_and_add((u_int32 *)&sp[j], 0u); //lint !e9005 atomic read
+    }
+  }
+}
+
+/*
+*
+* Helper print function for ftUpdateTestStatus().
+*
+*/
+static void printCountIfNonzero(u_int32 cnt, const char *name, char *tbuf,
+                                char *lbuf, int32 *pfCnt)
+{
+  if(cnt != 0u)
+  {
+    sprintf(tbuf,"                         %-9s %4.4lu\n",name,cnt);
+    strcat(lbuf,tbuf);
+    (*pfCnt)++;
+  }
+}
+
+/*
+*
+* Updates the status of the overall test.
+* This function always returns the value passed in for "ret"
+*
+*/
+ftRet_t ftUpdateTestStatus(ftResults_t *ftres, ftRet_t ret, const char *descr)
+{
+  // descr may fill a client's MUST_BE_BIG_ENOUGH buffer, the counts follow it
+  char lbuf[LOG_REC_SZ + MUST_BE_BIG_ENOUGH],tbuf[LOG_REC_SZ];
+  ftCounts_t *cp = ftSlot(ftres);
+  ftCounts_t tot, own;
+  int32 i;
+  int32 passCnt=0;
+  int32 failCnt=0;
+  bool  getOut = false;
+  bool  testFailed = false;
+  bool  interrupted;
 
+  lbuf[0] = '\0'; tbuf[0] = '\0';
+
+  /*
+  * Only start, complete and information lines are logged. The line
+  * prefix is built for those alone so counter updates stay cheap.
+  */
   switch(ret){
     case ftStart:
-      ftResults.ftStartCnt++;
+      ftCountBump(&ftSlot(&ftResults)->ftStartCnt);
+      ftLogPrefix(lbuf);
       strcat(lbuf,"STARTING ");
+      if (ftThreadName != NULL)
+      {
+        strcat(lbuf,ftThreadName);
+      }
       break;
     case ftComplete:
       /*
@@ -640,109 +1597,118 @@ ftRet_t ftUpdateTestStatus(ftResults_t *ftres, ftRet_t ret, const char *descr)
       * along with pass/error counts
       *
       */
-      if ((ftres->ftFailCnt != 0u)   || (ftres->ftErrorCnt != 0u)   ||
-          (ftres->ftSignalCnt != 0u) || (ftres->ftTxErrorCnt != 0u) ||
-          (ftres->ftTxFailCnt != 0u) || (ftres->ftRxErrorCnt != 0u) ||
-          (ftres->ftRxTimeoutCnt != 0u) || (ftres->ftRxFailCnt != 0u) )
+      ftLogPrefix(lbuf);
+      ftSumResults(ftres, &tot); // merge the per-thread slots
+
+      if ((tot.ftFailCnt != 0u)   || (tot.ftErrorCnt != 0u)   ||
+          (tot.ftSignalCnt != 0u) || (tot.ftTxErrorCnt != 0u) ||
+          (tot.ftTxFailCnt != 0u) || (tot.ftRxErrorCnt != 0u) ||
+          (tot.ftRxTimeoutCnt != 0u) || (tot.ftRxFailCnt != 0u) )
       {
         if (descr == NULL)
         {
-          sprintf (tbuf, "%s TEST HAS FAILED\n",ftTestName);
+          snprintf (tbuf, sizeof(tbuf), "%.64s TEST HAS FAILED\n",FT_NAME());
         }
         else
         {
-          sprintf (tbuf, "%s TEST HAS FAILED FOR %s\n",ftTestName, descr);
+          snprintf (tbuf, sizeof(tbuf), "%.64s TEST HAS FAILED FOR %s\n",FT_NAME(), descr);
         }
-        strcat (lbuf, tbuf);
+        strncat (lbuf, tbuf, sizeof(lbuf) - strlen(lbuf) - 1u);
         fitPrint(PASSFAIL, "%s",lbuf);
         testFailed = true;
       }
-      else if (ftres->ftPassCnt != 0u)
+      else if (tot.ftPassCnt != 0u)
       {
-        sprintf (tbuf, "%s TEST HAS PASSED\n",ftTestName);
-        strcat (lbuf, tbuf);
+        snprintf (tbuf, sizeof(tbuf), "%.64s TEST HAS PASSED\n",FT_NAME());
+        strncat (lbuf, tbuf, sizeof(lbuf) - strlen(lbuf) - 1u);
         fitPrint(PASSFAIL, "%s",lbuf);
       }
       else
       {
-        sprintf (tbuf, "%s TEST DID NOT RUN CORRECTLY\n",ftTestName);
-        strcat (lbuf, tbuf);
+        snprintf (tbuf, sizeof(tbuf), "%.64s TEST DID NOT RUN CORRECTLY\n",FT_NAME());
+        strncat (lbuf, tbuf, sizeof(lbuf) - strlen(lbuf) - 1u);
         fitPrint(PASSFAIL, "%s",lbuf);
         testFailed = true;
       }
 
-      ftres->ftCompleteCnt++;
+      ftCountBump(&cp->ftCompleteCnt);
+      ftThreadFailed = ftThreadFailed || testFailed;
 
-      printCountIfNonzero(ftres->ftPassCnt,     "Pass",     tbuf,lbuf,&passCnt);
-      printCountIfNonzero(ftres->ftFailCnt,     "Fail",     tbuf,lbuf,&failCnt);
-      printCountIfNonzero(ftres->ftErrorCnt,    "Error",    tbuf,lbuf,&failCnt);
-      printCountIfNonzero(ftres->ftSignalCnt,   "Signal",   tbuf,lbuf,&failCnt);
-      printCountIfNonzero(ftres->ftTxErrorCnt,  "TxError",  tbuf,lbuf,&failCnt);
-      printCountIfNonzero(ftres->ftTxFailCnt,   "TxFail",   tbuf,lbuf,&failCnt);
-      printCountIfNonzero(ftres->ftRxErrorCnt,  "RxError",  tbuf,lbuf,&failCnt);
-      printCountIfNonzero(ftres->ftRxTimeoutCnt,"RxTimeout",tbuf,lbuf,&failCnt);
-      printCountIfNonzero(ftres->ftRxFailCnt,   "RxFail",   tbuf,lbuf,&failCnt);
+      printCountIfNonzero(tot.ftPassCnt,     "Pass",     tbuf,lbuf,&passCnt);
+      printCountIfNonzero(tot.ftFailCnt,     "Fail",     tbuf,lbuf,&failCnt);
+      printCountIfNonzero(tot.ftErrorCnt,    "Error",    tbuf,lbuf,&failCnt);
+      printCountIfNonzero(tot.ftSignalCnt,   "Signal",   tbuf,lbuf,&failCnt);
+      printCountIfNonzero(tot.ftTxErrorCnt,  "TxError",  tbuf,lbuf,&failCnt);
+      printCountIfNonzero(tot.ftTxFailCnt,   "TxFail",   tbuf,lbuf,&failCnt);
+      printCountIfNonzero(tot.ftRxErrorCnt,  "RxError",  tbuf,lbuf,&failCnt);
+      printCountIfNonzero(tot.ftRxTimeoutCnt,"RxTimeout",tbuf,lbuf,&failCnt);
+      printCountIfNonzero(tot.ftRxFailCnt,   "RxFail",   tbuf,lbuf,&failCnt);
 
      // FIT signal handler catches this, use this result buffer
-      if(ftResults.ftInterruptCnt != 0u){
+      ftSumResults(&ftResults, &own);
+      interrupted = (own.ftInterruptCnt != 0u) || (ftSigIntCnt != 0);
+      if(interrupted){
         strcat(lbuf, "                         Test Interrupted\n");
       }
 
+      ftRecordComplete(&tot, testFailed, interrupted, descr);
+
       break;
     case ftPass:
-      ftres->ftPassCnt++;
+      ftCountBump(&cp->ftPassCnt);
       getOut = true;
       break;
     case ftFail:
-      ftres->ftFailCnt++;
+      ftCountBump(&cp->ftFailCnt);
       getOut = true;
       break;
     case ftError:
-      ftres->ftErrorCnt++;
+      ftCountBump(&cp->ftErrorCnt);
       getOut = true;
       break;
     case ftSignal:
-      ftres->ftSignalCnt++;
+      ftCountBump(&cp->ftSignalCnt);
       getOut = true;
       break;
     case ftTxError:
-      ftres->ftTxErrorCnt++;
+      ftCountBump(&cp->ftTxErrorCnt);
       getOut = true;
       break;
     case ftTxTimeout:
-      ftres->ftTxFailCnt++;
+      ftCountBump(&cp->ftTxFailCnt);
       getOut = true;
       break;
     case ftTxFail:
-      ftres->ftTxFailCnt++;
+      ftCountBump(&cp->ftTxFailCnt);
       getOut = true;
       break;
     case ftRxError:
-      ftres->ftRxErrorCnt++;
+      ftCountBump(&cp->ftRxErrorCnt);
       getOut = true;
       break;
     case ftRxTimeout:
-      ftres->ftRxTimeoutCnt++;
+      ftCountBump(&cp->ftRxTimeoutCnt);
       getOut = true;
       break;
     case ftRxFail:
-      ftres->ftRxFailCnt++;
+      ftCountBump(&cp->ftRxFailCnt);
       getOut = true;
       break;
     case ftNewline:
-      ftres->ftNewlineCnt++;
+      ftCountBump(&cp->ftNewlineCnt);
       getOut = true;
       break;
     case ftInformation:
-      ftres->ftInformationCnt++;
+      ftCountBump(&cp->ftInformationCnt);
+      ftLogPrefix(lbuf);
       break;
     case ftInterrupt:
-      ftResults.ftInterruptCnt++;
+      ftCountBump(&ftSlot(&ftResults)->ftInterruptCnt);
       getOut = true;
       break;
     case ftUnimplemented:
     default:
-      ftResults.ftUnimplementedCnt++;
+      ftCountBump(&ftSlot(&ftResults)->ftUnimplementedCnt);
       getOut = true;
       break;
   }
@@ -763,9 +1729,408 @@ ftRet_t ftUpdateTestStatus(ftResults_t *ftres, ftRet_t ret, const char *descr)
 
   fitPrint(LOG, "%s\n", lbuf); // output to logfile
 
+  if (ret == ftComplete)
+  {
+    ftLogFlush(); // results are on the media before the test returns
+  }
+
   return ret;
 }
 
+/*
+*
+* Test plan runner
+*
+* 'fit run plan' runs the clients listed in a plan file on a fixed set of
+* worker threads inside this one process, replacing the shell loops of
+* conf/go. Each plan line is
+*
+*   test  period  group  resources  [client options]
+*
+* period    seconds to idle after each run of the test
+* group     entries sharing a concurrency group run one after another in
+*           plan order, each group gets its own worker thread; '-' puts
+*           the entry in a group of its own
+* resources comma separated names held exclusively while the test runs,
+*           e.g. sp5s for serial and fio_monitor; '-' for none
+*
+* A client is never run by two workers at once, its module data is not
+* reentrant. Counts accumulate per client over the run, as with -I.
+*
+*/
+#define PLAN_MAX_ENTRIES 32u
+#define PLAN_MAX_ARGS    16u
+#define PLAN_MAX_RES     32u  // bits in a resource mask
+#define PLAN_NAME_SZ     32u
+
+typedef struct {
+  const ft *test;
+  char      line[MUST_BE_BIG_ENOUGH]; // argv[] points into this copy
+  char     *argv[PLAN_MAX_ARGS + 2u];
+  plint     argc;
+  u_int32   period;  // seconds idle after each run
+  u_int32   group;
+  u_int32   resMask; // exclusive resources held while running
+  u_int32   runs;
+  bool      failed;  // verdict of the last run
+} ftPlanEntry_t;
+
+typedef struct {
+  ftPlanEntry_t entry[PLAN_MAX_ENTRIES];
+  u_int32       entries;
+  char          resName[PLAN_MAX_RES][PLAN_NAME_SZ];
+  u_int32       resources;
+  char          groupName[PLAN_MAX_ENTRIES][PLAN_NAME_SZ];
+  u_int32       groupIdx[PLAN_MAX_ENTRIES]; // worker thread arguments
+  u_int32       groups;
+} ftPlan_t;
+
+static ftPlan_t        ftPlan;
+static u_int32         ftPlanPasses = 1u; // 0 runs until interrupted
+static u_int32         planBusy = 0u;     // resources currently held
+static pthread_mutex_t planMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  planCond = PTHREAD_COND_INITIALIZER;
+static ftResults_t     ftPlanResults = {0};
+
+/*
+*
+* Return the index of name in names[], adding it if not yet present.
+* Returns -1 when the table is full or the name is too long.
+*
+*/
+static int32 ftPlanIntern(char names[][PLAN_NAME_SZ], u_int32 *cnt, u_int32 max,
+                          const char *name)
+{
+  u_int32 i;
+
+  for(i=0u;i<*cnt;i++)
+  {
+    if(strcmp(names[i],name) == 0)
+    {
+      return((int32)i);
+    }
+  }
+
+  if((*cnt >= max) || (strlen(name) >= PLAN_NAME_SZ))
+  {
+    return(-1);
+  }
+
+  strcpy(names[*cnt],name);
+  (*cnt)++;
+
+  return((int32)i);
+}
+
+/*
+*
+* Add the comma separated resources in list to the entry
+*
+*/
+static int32 ftPlanResources(ftPlanEntry_t *ep, char *list)
+{
+  char   *tok,*save = NULL;
+  int32  idx;
+
+  for(tok = strtok_r(list,",",&save); tok != NULL; tok = strtok_r(NULL,",",&save))
+  {
+    idx = ftPlanIntern(ftPlan.resName,&ftPlan.resources,PLAN_MAX_RES,tok);
+    if(idx < 0)
+    {
+      return(-1);
+    }
+    ep->resMask |= (1u << (u_int32)idx);
+  }
+
+  return(0);
+}
+
+/*
+*
+* Read the plan file
+*
+*/
+static int32 ftPlanLoad(const char *planName)
+{
+  FILE    *fp;
+  char    buf[MUST_BE_BIG_ENOUGH];
+  char    *tok[4],*save,*cp;
+  u_int32 ln = 0u;
+  u_int32 i;
+  int32   idx;
+  ftPlanEntry_t *ep;
+
+  memset(&ftPlan, 0, sizeof(ftPlan));
+
+  fp = fopen(planName,"r");
+  if(fp == NULL)
+  {
+    fitPrint(ERROR, "run: cannot open plan %s, err %d, %s\n",
+             planName,errno,strerror(errno));
+    return(ENOFILE);
+  }
+
+  while(fgets(buf,sizeof(buf),fp) != NULL)
+  {
+    ln++;
+
+    cp = strchr(buf,'#'); // strip comments
+    if(cp != NULL)
+    {
+      *cp = '\0';
+    }
+
+    if(ftPlan.entries >= PLAN_MAX_ENTRIES)
+    {
+      fitPrint(ERROR, "run: %s:%lu more than %u entries\n",planName,ln,PLAN_MAX_ENTRIES);
+      break;
+    }
+
+    ep = &ftPlan.entry[ftPlan.entries];
+    strcpy(ep->line,buf);
+
+    save = NULL;
+    tok[0] = strtok_r(ep->line," \t\r\n",&save);
+    if(tok[0] == NULL)
+    {
+      continue; // blank line
+    }
+
+    for(i=1u;i<4u;i++)
+    {
+      tok[i] = strtok_r(NULL," \t\r\n",&save);
+      if(tok[i] == NULL)
+      {
+        fitPrint(ERROR, "run: %s:%lu expected test period group resources\n",
+                 planName,ln);
+        fclose(fp);
+        return(ENOARGS);
+      }
+    }
+
+    for(ep->test = ftTest; *ep->test->ftName != '\0'; ep->test++)
+    {
+      if(strcmp(ep->test->ftName,tok[0]) == 0)
+      {
+        break;
+      }
+    }
+
+    if((*ep->test->ftName == '\0') || (ep->test->ftfp == run))
+    {
+      fitPrint(ERROR, "run: %s:%lu %s test not supported\n",planName,ln,tok[0]);
+      fclose(fp);
+      return(ENOARGS);
+    }
+
+    ep->period = (u_int32)strtoul(tok[1],NULL,10);
+
+    if(strcmp(tok[2],"-") == 0)
+    {
+      // a group of its own, named after the plan line
+      sprintf(buf,"-%lu",ln);
+      tok[2] = buf;
+    }
+    idx = ftPlanIntern(ftPlan.groupName,&ftPlan.groups,PLAN_MAX_ENTRIES,tok[2]);
+    ep->group = (u_int32)idx;
+
+    // the client itself is an exclusive resource, its data is not reentrant
+    strcpy(buf,ep->test->ftName);
+    if((idx < 0) || (ftPlanResources(ep,buf) != 0) ||
+       ((strcmp(tok[3],"-") != 0) && (ftPlanResources(ep,tok[3]) != 0)))
+    {
+      fitPrint(ERROR, "run: %s:%lu too many groups or resources\n",planName,ln);
+      fclose(fp);
+      return(ENOBUF);
+    }
+
+    ep->argv[0] = (char *)ep->test->ftName;
+    for(ep->argc = 1; ep->argc < (plint)(PLAN_MAX_ARGS + 1u); ep->argc++)
+    {
+      ep->argv[ep->argc] = strtok_r(NULL," \t\r\n",&save);
+      if(ep->argv[ep->argc] == NULL)
+      {
+        break;
+      }
+    }
+    ep->argv[ep->argc] = NULL;
+
+    ftPlan.entries++;
+  }
+
+  fclose(fp);
+
+  for(i=0u;i<ftPlan.groups;i++)
+  {
+    ftPlan.groupIdx[i] = i;
+  }
+
+  return(0);
+}
+
+/*
+*
+* Take every resource in mask, or wait until they are all free
+*
+*/
+static void ftPlanAcquire(u_int32 mask)
+{
+  pthread_mutex_lock(&planMutex);
+  while((planBusy & mask) != 0u)
+  {
+    pthread_cond_wait(&planCond,&planMutex);
+  }
+  planBusy |= mask;
+  pthread_mutex_unlock(&planMutex);
+}
+
+static void ftPlanRelease(u_int32 mask)
+{
+  pthread_mutex_lock(&planMutex);
+  planBusy &= ~mask;
+  pthread_cond_broadcast(&planCond);
+  pthread_mutex_unlock(&planMutex);
+}
+
+/*
+*
+* Called by clients once they are done with getopt(), optind and optarg
+* are shared by every thread. Harmless when not running a plan.
+*
+*/
+void ftArgsDone(void)
+{
+  if(ftArgHeld)
+  {
+    ftArgHeld = false;
+    pthread_mutex_unlock(&ftArgMutex);
+  }
+}
+
+/*
+*
+* Plan worker, runs the entries of one concurrency group
+*
+*/
+static void *ftPlanWorker(void *arg)
+{
+  const u_int32 group = *(const u_int32 *)arg;
+  ftPlanEntry_t *ep;
+  u_int32 pass,i,s;
+
+  for(pass=0u; keepGoing && ((ftPlanPasses == 0u) || (pass < ftPlanPasses)); pass++)
+  {
+    for(i=0u; keepGoing && (i < ftPlan.entries); i++)
+    {
+      ep = &ftPlan.entry[i];
+      if(ep->group != group)
+      {
+        continue;
+      }
+
+      ftPlanAcquire(ep->resMask);
+
+      if(ep->test->ftOpts)
+      {
+        pthread_mutex_lock(&ftArgMutex);
+        ftArgHeld = true;
+        optind = 0; // restart getopt() for this client
+      }
+
+      ftThreadName = ep->test->ftName;
+      ftThreadFailed = false;
+      (void) ftUpdateTestStatus(ftrp,ftStart,NULL);
+      (void) ep->test->ftfp(ep->argc,ep->argv);
+      ftArgsDone();
+
+      ftPlanRelease(ep->resMask);
+
+      ep->runs++;
+      ep->failed = ftThreadFailed;
+
+      for(s=0u; keepGoing && (s < ep->period); s++)
+      {
+        sleep(1);
+      }
+    }
+  }
+
+  return(NULL);
+}
+
+/*
+*
+* fit run
+*
+*/
+static ftRet_t run(plint argc,char * const argv[])
+{
+  pthread_t tid[PLAN_MAX_ENTRIES];
+  u_int32 i,started = 0u;
+  int32   ret;
+  char    lbuf[MUST_BE_BIG_ENOUGH];
+  ftPlanEntry_t *ep;
+
+  if((argc != 2) || (argv[1][0] == '-'))
+  {
+    fitPrint(USER, "Usage: %s plan\n",argv[0]);
+    fitPrint(USER, "Runs the tests listed in the plan file in parallel, one line per test:\n" \
+             "\ttest period group resources [test options]\n" \
+             "\tperiod    seconds to wait after each run\n" \
+             "\tgroup     tests in the same group run in turn, - for a group of its own\n" \
+             "\tresources comma separated exclusive resources (e.g. sp5s), - for none\n" \
+             "The fit -I count applies to each group (0 for continuous).\n\n");
+    fitLicense();
+    return(ftComplete);
+  }
+
+  ret = ftPlanLoad(argv[1]);
+  if(ret != 0)
+  {
+    ftUpdateTestStatus(&ftPlanResults,ftError,NULL);
+    return(ftUpdateTestStatus(&ftPlanResults,ftComplete,argv[1]));
+  }
+
+  for(i=0u;i<ftPlan.groups;i++)
+  {
+    ret = pthread_create(&tid[started],NULL,ftPlanWorker,&ftPlan.groupIdx[i]);
+    if(ret != 0)
+    {
+      fitPrint(ERROR, "run: cannot start group %s, err %d, %s\n",
+               ftPlan.groupName[i],ret,strerror(ret));
+      ftUpdateTestStatus(&ftPlanResults,ftError,NULL);
+      continue;
+    }
+    started++;
+  }
+
+  for(i=0u;i<started;i++)
+  {
+    (void) pthread_join(tid[i],NULL);
+  }
+
+  /*
+  * One summary line per plan entry
+  */
+  for(i=0u;i<ftPlan.entries;i++)
+  {
+    ep = &ftPlan.entry[i];
+
+    sprintf(lbuf,"%-12s %-10s runs %6lu  last %s\n",ep->test->ftName,
+            ftPlan.groupName[ep->group],ep->runs,
+            (ep->runs == 0u) ? "none" : (ep->failed ? "FAILED" : "passed"));
+    fitPrint(VERBOSE, "%s",lbuf);
+    fitPrint(LOG, "%s",lbuf);
+
+    if(ep->runs != 0u)
+    {
+      ftUpdateTestStatus(&ftPlanResults,ep->failed ? ftFail : ftPass,NULL);
+    }
+  }
+
+  return(ftUpdateTestStatus(&ftPlanResults,ftComplete,NULL));
+}
+
 /*
 *
 * Compact NULL argument vectors
@@ -826,7 +2191,11 @@ static void fitUsage(void){
            "\t-F to enable fail-only logging\n" \
            "\t-L to enable logging\n" \
            "\t-I count to run the test iteratively (default 1; 0 for continuous)\n" \
-           "\t-V to allow verbose printout\n\n");
+           "\t-S msec log sync interval (default %d; 0 to sync every write)\n" \
+           "\t-R file to append structured results to file as JSON lines\n" \
+           "\t-P serial port backend, dev:directory (default dev:/dev/) or simulated\n" \
+           "\t   ports sim:lat=usec,flip=bits,baud=rate,cable=spA-spB\n" \
+           "\t-V to allow verbose printout\n\n", LOG_SYNC_MS);
   fitLicense();
 }
 
@@ -855,7 +2224,11 @@ static void sig_handler(int sig)
   if (sig == SIGINT)
   {
     keepGoing = false;
-    ftResults.ftInterruptCnt++;
+    ftSigIntCnt++; // not through ftSlot(), nothing there is async-signal-safe
+    if (logAsync)
+    {
+      (void) sem_post(&logSem); // async-signal-safe, wake the logger
+    }
   }
 }
 
@@ -875,6 +2248,7 @@ int main(int argc, char * argv[]) // argv[] must NOT be const in this case
   int32 c;
   bool  testFound = false;
   bool  runContinuous = false;
+  const char *resultFileName = NULL;
   struct sigaction sigact;
 
   c = strcmp((char *)basename(argv[0]),"fit");
@@ -906,7 +2280,7 @@ int main(int argc, char * argv[]) // argv[] must NOT be const in this case
   */
 
   opterr = 0;
-  c = getopt(argc,argv,"-LFVI:");
+  c = getopt(argc,argv,"-LFVI:S:R:P:");
 
   while(c != -1)
   {
@@ -927,6 +2301,22 @@ int main(int argc, char * argv[]) // argv[] must NOT be const in this case
           runContinuous = true; // run forever
         }
 
+        argv[optind - 1] = NULL;
+        argv[optind - 2] = NULL;
+        break;
+      case 'S':
+        logSyncMs = strtol(optarg,NULL,10);
+
+        if (logSyncMs < 0)
+        {
+          logSyncMs = LOG_SYNC_MS;
+        }
+
+        argv[optind - 1] = NULL;
+        argv[optind - 2] = NULL;
+        break;
+      case 'R':
+        resultFileName = optarg;
         argv[optind - 1] = NULL;
         argv[optind - 2] = NULL;
         break;
@@ -934,11 +2324,16 @@ int main(int argc, char * argv[]) // argv[] must NOT be const in this case
         verboseFlag = true;
         argv[optind - 1] = NULL;
         break;
+      case 'P':
+        ftPortSpec = optarg;
+        argv[optind - 1] = NULL;
+        argv[optind - 2] = NULL;
+        break;
       default:
         // nothing to do
         break;
     }
-    c = getopt(argc,argv,"-LFVI:");
+    c = getopt(argc,argv,"-LFVI:S:R:P:");
   }
 
   optind = 0; // for reentrancy
@@ -948,7 +2343,8 @@ int main(int argc, char * argv[]) // argv[] must NOT be const in this case
   * can self configure appropriately.
   */
 
-  targetARCH = getTargetArch(); // run with whatever is found
+  ftInitIdentity();
+  targetARCH = ftIdentity.arch; // run with whatever is found
 
   /*
   *
@@ -1008,6 +2404,23 @@ int main(int argc, char * argv[]) // argv[] must NOT be const in this case
         }
       }
 
+      if(resultFileName != NULL)
+      {
+        // open structured results file for append
+        ftResultfp = fopen(resultFileName,"a");
+        if(ftResultfp == NULL){
+          fitPrint(ERROR, "%s: cannot open results file %s, err %d, %s\n",
+                   testName,resultFileName,errno,strerror(errno));
+          return(ENOFILE);
+        }
+      }
+
+      if(logfileFlag || logFailureFileFlag || (ftResultfp != NULL))
+      {
+        ftLogStart();
+        (void) atexit(ftLogStop); // clients may exit() from usage
+      }
+
       strcpy(ftTestName,ftTest[i].ftName);
       ftUpdateTestStatus(ftrp,ftStart,NULL);
 
@@ -1017,11 +2430,20 @@ int main(int argc, char * argv[]) // argv[] must NOT be const in this case
       *
       */
 
+      if (ftTest[i].ftfp == run)
+      {
+        // the plan runner applies the iteration count to each group
+        ftPlanPasses = runContinuous ? 0u : (u_int32)MAX(iter,1);
+        runContinuous = false;
+        iter = 1;
+      }
+
       clock_gettime(CLOCK_MONOTONIC,&start_tm); // start interval timing
 
       do {
 
         memset(&ftResults, 0, sizeof(ftResults)); // reset the test counts
+        optind = 0; // the test parses its options again on every iteration
         (void) ftTest[i].ftfp(argc - j,&argv[j]); // call the test
         --iter;
       } while( keepGoing && (runContinuous || (iter > 0)) );
@@ -1045,8 +2467,16 @@ int main(int argc, char * argv[]) // argv[] must NOT be const in this case
 
       fitPrint(LOG, "                         ELAPSED TIME %16.2f S\n\n",t_s);
 
+      ftLogStop(); // drain the log ring before the files go away
+
+      if(ftResultfp != NULL){
+        fclose(ftResultfp);
+        ftResultfp = NULL;
+      }
+
       if(logfileFlag){
         fclose(ftLogfp);// close logfile file pointer
+        ftLogfp = NULL;
       }
 
       break; // this test has finished
@@ -1070,7 +2500,11 @@ void fitPrint(ftPrintLevels_t printLevel, const char *format, ...)
   switch (printLevel)
   {
     case LOG:
-      if (logfileFlag)
+      if (logfileFlag && logAsync)
+      {
+        ftLogPut(LOG, format, args);
+      }
+      else if (logfileFlag)
       {
         if (ftLogfp != NULL)
         {
@@ -1079,8 +2513,26 @@ void fitPrint(ftPrintLevels_t printLevel, const char *format, ...)
       }
       break;
 
+    case RESULT:
+      if (ftResultfp != NULL)
+      {
+        if (logAsync)
+        {
+          ftLogPut(RESULT, format, args);
+        }
+        else
+        {
+          vfprintf (ftResultfp, format, args);
+        }
+      }
+      break;
+
     case LOG_FAILURE:
-      if (logFailureFileFlag)
+      if (logFailureFileFlag && logAsync)
+      {
+        ftLogPut(LOG_FAILURE, format, args);
+      }
+      else if (logFailureFileFlag)
       {
         ftFailLogfp = fopen(failLogFilename, "a");
 
@@ -1149,7 +2601,7 @@ int32 readTimeout(int32 fd,void *buf,size_t nbytes,int32 timeoutSeconds)
   {
     // Select timed out
     fitPrint(VERBOSE, "%s: %s select timed out reading from fd %ld, sz %4.4u\n",
-             __func__,ftTestName,fd,nbytes);
+             __func__,FT_NAME(),fd,nbytes);
     ftUpdateTestStatus(ftrp,ftRxTimeout,NULL);
     retval = -1;
     errno = ETIMEDOUT;
@@ -1160,7 +2612,7 @@ int32 readTimeout(int32 fd,void *buf,size_t nbytes,int32 timeoutSeconds)
     retval = read(fd,buf,nbytes);
     if (retval < 0)
     {
-      fitPrint(ERROR,"%s: Error reading for test %s: %s\n",__func__,ftTestName,
+      fitPrint(ERROR,"%s: Error reading for test %s: %s\n",__func__,FT_NAME(),
                strerror(errno));
       ftUpdateTestStatus(ftrp,ftRxError,NULL);
       retval = -2;
@@ -1169,7 +2621,7 @@ int32 readTimeout(int32 fd,void *buf,size_t nbytes,int32 timeoutSeconds)
   else // retval < 0
   {
     fitPrint(ERROR,"%s: select error for test %s: %s\n",
-             __func__,ftTestName,strerror(errno));
+             __func__,FT_NAME(),strerror(errno));
     ftUpdateTestStatus(ftrp,ftRxError,NULL);
     retval = -3;
   }
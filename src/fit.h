@@ -34,8 +34,15 @@
     #include "ftypes.h"
   #endif
 
+  #ifndef _TIME_H
+    #include <time.h>
+  #endif
+
   #define MUST_BE_BIG_ENOUGH 512u
 
+  #define CRC_INIT   0xffffu // initial FCS for genCrcUpdate()
+  #define CRC_SLICES 8u      // bytes folded per step by genCrc()
+
   // Custom error codes for the M-Fit suite
   #define ENOARGS -20
   #define ENOFILE -21
@@ -59,9 +66,42 @@
          ftStartCnt, ftCompleteCnt, ftPassCnt, ftFailCnt, ftErrorCnt, ftSignalCnt,
          ftTxErrorCnt, ftTxFailCnt, ftRxErrorCnt, ftRxTimeoutCnt, ftRxFailCnt,
          ftNewlineCnt, ftInformationCnt, ftUnimplementedCnt, ftInterruptCnt;
+  } ftCounts_t;
+
+  /*
+  * Test results are sharded into cache line sized slots. Each thread
+  * bumps its own slot atomically and the slots are merged at ftComplete,
+  * so concurrent port threads neither lose counts nor share lines.
+  */
+  #define FT_CACHE_LINE   64u // covers the 32 byte e300 line as well
+  #define FT_RESULT_SLOTS 32u // a reader and a writer on each of the 11 serial
+                              // ports plus the main and helper threads; one
+                              // bit each in ftSlotUsed, slots are recycled
+
+  typedef struct {
+    ftCounts_t cnt;
+  } __attribute__ ((aligned (FT_CACHE_LINE))) ftResultSlot_t;
+
+  typedef struct {
+    ftResultSlot_t slot[FT_RESULT_SLOTS];
   } ftResults_t;
 
-  typedef enum { ERROR, VERBOSE, USER, PASSFAIL, LOG_FAILURE, LOG } ftPrintLevels_t;
+  typedef enum { ERROR, VERBOSE, USER, PASSFAIL, LOG_FAILURE, LOG, RESULT } ftPrintLevels_t;
+
+  /*
+  * A structured result, written as one JSON line to the fit -R file.
+  * Unused fields are left zero or NULL and are omitted from the line.
+  */
+  typedef struct {
+    const char      *test;         // client name, NULL for the running test
+    const char      *event;        // record kind, NULL for "frame"
+    const char      *rx, *tx;      // port pair
+    u_int32          baud;
+    size_t           size;         // frame size in bytes
+    ftRet_t          result;
+    u_int32          okCnt, ngCnt; // summary records
+    struct timespec  start, end;   // CLOCK_MONOTONIC
+  } ftRecord_t;
 
   typedef enum { ARCH_UNKNOWN, ARCH_82XX, ARCH_83XX } ftArchUnderTest_t;
 
@@ -69,6 +109,7 @@
   extern ftArchUnderTest_t targetARCH;
   extern bool verboseFlag;
   extern bool keepGoing;
+  extern const char *ftPortSpec; // serial port backend, fit -P
 
 
   extern ftRet_t datakeyFit(plint argc, char * const argv[]);
@@ -88,13 +129,56 @@
   extern ftRet_t todFit(plint argc, char * const argv[]);
 
   extern ftRet_t ftUpdateTestStatus(ftResults_t *ftres,ftRet_t ret,const char *descr);
+  extern void ftSumResults(const ftResults_t *ftres, ftCounts_t *tot);
+  extern void ftArgsDone(void);
+  extern bool ftRecording(void);
+  extern void ftRecord(const ftRecord_t *rp);
+
+  /*
+  * Log bucketed histogram, see ftHistAdd()
+  */
+  #define HIST_SUB_BITS 3u                    // 8 buckets per power of 2
+  #define HIST_BUCKETS  (30u << HIST_SUB_BITS) // spans every u_int32 value
+
+  typedef struct {
+    u_int32 cnt[HIST_BUCKETS];
+    u_int32 n, min, max;
+    float64 sum;
+  } ftHist_t;
+
+  extern void    ftHistAdd(ftHist_t *hp, u_int32 val);
+  extern void    ftHistMerge(ftHist_t *dst, const ftHist_t *src);
+  extern u_int32 ftHistPct(const ftHist_t *hp, float64 pct);
+
+  /*
+  * Compact histogram for large arrays of them, see ftHistCAdd()
+  */
+  #define HISTC_SUB_BITS 2u                      // 4 buckets per power of 2
+  #define HISTC_BUCKETS  (30u << HISTC_SUB_BITS)
+
+  typedef struct {
+    u_int16 cnt[HISTC_BUCKETS]; // halved together rather than wrap
+    u_int32 n, max;
+    float64 sum;
+  } ftHistC_t;
+
+  extern void    ftHistCAdd(ftHistC_t *hp, u_int32 val);
+  extern u_int32 ftHistCPct(const ftHistC_t *hp, float64 pct);
 
   extern void *createSharedMemory (const char *fileName, int32 *shmid, size_t mem_size);
+  #define HEX_ROW_BYTES 32u // bytes per memory dump row
+
+  typedef bool (*mdmpHilite_t)(size_t idx, u_int8 val);
+
+  extern void mdmpRows(const void *vp, size_t sz, ftPrintLevels_t printLevel,
+                       const char *pre, const char *sep, const char *post,
+                       size_t grp, mdmpHilite_t hilite);
   extern void mdmp(const void *vp, size_t sz, ftPrintLevels_t printLevel);
   extern void mdmp1(const void *vp, size_t sz, ftPrintLevels_t printLevel,
                     const char *fp, const char *fn, int32 ln, const char *us);
   extern void dmpargs(plint argc,char * const argv[],char *cp);
   extern u_int16 genCrc(const void *saddr, const void *eaddr);
+  extern u_int16 genCrcUpdate(u_int16 fcs, const void *buf, size_t len);
 
 
   extern void fitPrint(ftPrintLevels_t printLevel, const char *format, ...);
@@ -36,6 +36,7 @@
     typedef unsigned short  u_int16;
     typedef unsigned int    u_plint; // plain unsigned of indefinite size
     typedef unsigned long   u_int32;
+    typedef unsigned long long u_int64; // two 32-bit accesses on the e300
     typedef float           float32;
     typedef double          float64;
   #else
@@ -28,6 +28,9 @@
 #include <errno.h>
 #include <unistd.h>
 #include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/mount.h>
 #include <mntent.h>  // getmntent(), hasmntent()
@@ -37,9 +40,71 @@
 static ftResults_t ftResults = {0};
 static ftResults_t *ftrp = &ftResults;
 
+#define MEM_HEAP_SZ     0x2000000u // heap block under test
+#define MEM_THREADS_MAX 16u        // stripes of the parallel test
+#define MEM_ONES        (~(u_int64)0)
+#define MEM_FILL(b)     ((u_int64)0x0101010101010101ULL * (u_int64)(b)) // byte in every lane
+#define MEM_ELEMS       6u         // March elements of an algorithm
+
 // global data memory for testing
 static int32 idat[0x80000]; // initialized to 0's, check this
 
+/*
+* A stripe of the parallel memory test, one per thread. Stripes start on
+* cache lines so no two threads share one.
+*/
+typedef struct _memStripe {
+  volatile u_int64       *base;
+  size_t                  words;
+  const struct _memPat   *pat;
+  volatile u_int64       *badp;   // first failing word, NULL if none
+  u_int64                 expect,actual;
+  pthread_t               tid;
+} __attribute__ ((aligned (FT_CACHE_LINE))) memStripe_t;
+
+typedef bool (*memKernel_t)(memStripe_t *msp);
+
+/*
+* March algorithms as data: elements of read/write operations applied to
+* each word in turn, ascending or descending. 0 is the all zero background,
+* 1 its inverse.
+*/
+typedef enum { mR0, mR1, mW0, mW1 } memOp_t;
+
+typedef struct _memElem {
+  int8    dir;                    // 1 ascending, -1 descending
+  u_int8  n;
+  u_int8  op[6];                  // memOp_t
+} memElem_t;
+
+typedef struct _memMarch {
+  u_int8    n;
+  memElem_t e[MEM_ELEMS];
+} memMarch_t;
+
+typedef struct _memPat {
+  const char       *key;          // -p name
+  const char       *name;
+  memKernel_t       kernel;
+  const memMarch_t *march;        // memMarch() algorithm
+  u_int32           accesses;     // word accesses per word, for the bandwidth
+  bool              dflt;         // run without -p
+} memPat_t;
+
+static memStripe_t memStripe[MEM_THREADS_MAX];
+static u_int64     memSeed = 1u;  // -s
+
+/*
+* Failing word: where, what was expected, what was read and which bits differ
+*/
+static void memReport(const char *name,volatile const void *addr,u_int32 bytes,
+                      u_int64 expect,u_int64 actual)
+{
+  fitPrint(VERBOSE, "%s failed at %p: read 0x%0*llx, expected 0x%0*llx, bits 0x%0*llx\n",
+           name,addr,(plint)(bytes * 2u),actual,(plint)(bytes * 2u),expect,
+           (plint)(bytes * 2u),expect ^ actual);
+}
+
 /*
 *
 * destructive memory test
@@ -62,9 +127,8 @@ static u_int32 dmtest(void *vp,size_t sz)
     for(lbit=1;lbit!=0u;lbit<<=1){
       *lp = lbit;
       if(*lp != lbit){
-        fitPrint(VERBOSE, "walking 1's read 0x%08lx; expected 0x%08lx at loop %u of %u\n",
-                 lbit,*lp,bwcnt,sz/4u);
-        return(lbit);
+        memReport("32-bit walking 1's",lp,4u,lbit,*lp);
+        return(1u);
       }
     }
     lp++;
@@ -75,9 +139,8 @@ static u_int32 dmtest(void *vp,size_t sz)
     for(sbit=1;sbit!=0u;sbit<<=1){
       *sp = sbit;
       if(*sp != sbit){
-        fitPrint(VERBOSE, "walking 1's read 0x%04x; expected 0x%04x at loop %u of %u\n",
-                 sbit,*sp,bwcnt,sz/2u);
-        return(sbit);
+        memReport("16-bit walking 1's",sp,2u,sbit,*sp);
+        return(1u);
       }
     }
     sp++;
@@ -88,9 +151,8 @@ static u_int32 dmtest(void *vp,size_t sz)
     for(cbit=1;cbit!=0u;cbit<<=1){
       *cp = cbit;
       if(*cp != cbit){
-        fitPrint(VERBOSE, "walking 1's read 0x%02x; expected 0x%02x at loop %u of %u\n",
-                 cbit,*sp,bwcnt,sz);
-        return(cbit);
+        memReport("8-bit walking 1's",cp,1u,cbit,*cp);
+        return(1u);
       }
     }
     cp++;
@@ -116,8 +178,8 @@ static u_int32 dmtest(void *vp,size_t sz)
   {
     if (*cp != (u_int8)0xff)
     {
-      fitPrint(VERBOSE, "0xaa|0x55=>0xff test failed with 0x%02x at %p\n",*cp, cp);
-      return((u_int32)cp);  //lint !e9078 convert pointer to proper type for return
+      memReport("0xaa|0x55=>0xff",cp,1u,0xffu,*cp);
+      return(1u);
     }
     cp++;
   }
@@ -126,6 +188,432 @@ static u_int32 dmtest(void *vp,size_t sz)
 }
 
 
+/*
+*
+* Parallel memory test
+*
+* The region is split into one cache line aligned stripe per thread and
+* every pattern runs on all stripes at once, so the bus sees concurrent
+* traffic. Unlike dmtest() the kernels stream 64-bit words at full speed,
+* word accesses are only kept in order by volatile.
+*
+*/
+
+static bool memBad(memStripe_t *msp,volatile u_int64 *p,u_int64 expect,u_int64 actual)
+{
+  msp->badp = p;
+  msp->expect = expect;
+  msp->actual = actual;
+  return(false);
+}
+
+// walking 1's through every word
+static bool memWalk(memStripe_t *msp)
+{
+  volatile u_int64 *p = msp->base;
+  size_t  n;
+  u_int64 bit,val;
+
+  for(n = msp->words;n != 0u;n--)
+  {
+    for(bit = 1u;bit != 0u;bit <<= 1)
+    {
+      *p = bit;
+      val = *p;
+      if(val != bit)
+      {
+        return(memBad(msp,p,bit,val));
+      }
+    }
+    p++;
+  }
+
+  return(true);
+}
+
+// 0xaa|0x55=>0xff
+static bool memOr(memStripe_t *msp)
+{
+  volatile u_int64 *p;
+  size_t  n;
+  u_int64 val;
+
+  for(p = msp->base,n = msp->words;n != 0u;n--,p++)
+  {
+    *p = MEM_FILL(0xaau);
+  }
+
+  for(p = msp->base,n = msp->words;n != 0u;n--,p++)
+  {
+    *p |= MEM_FILL(0x55u);
+  }
+
+  for(p = msp->base,n = msp->words;n != 0u;n--,p++)
+  {
+    val = *p;
+    if(val != MEM_ONES)
+    {
+      return(memBad(msp,p,MEM_ONES,val));
+    }
+  }
+
+  return(true);
+}
+
+/*
+* Moving inversions: fill with a pattern, then ascending check it and write
+* its inverse, then descending check the inverse and write the pattern back
+*/
+static bool memMovInvOne(memStripe_t *msp,u_int64 pat)
+{
+  volatile u_int64 *p;
+  size_t  n;
+  u_int64 val;
+
+  for(p = msp->base,n = msp->words;n != 0u;n--,p++)
+  {
+    *p = pat;
+  }
+
+  for(p = msp->base,n = msp->words;n != 0u;n--,p++)
+  {
+    val = *p;
+    if(val != pat)
+    {
+      return(memBad(msp,p,pat,val));
+    }
+    *p = ~pat;
+  }
+
+  for(p = &msp->base[msp->words],n = msp->words;n != 0u;n--)
+  {
+    p--;
+    val = *p;
+    if(val != ~pat)
+    {
+      return(memBad(msp,p,~pat,val));
+    }
+    *p = pat;
+  }
+
+  return(true);
+}
+
+static bool memMovInv(memStripe_t *msp)
+{
+  return(memMovInvOne(msp,0u) && memMovInvOne(msp,MEM_FILL(0x55u)));
+}
+
+/*
+* Address in address: each 32-bit half of the word holds its own address,
+* so both halves see a pattern unique to them
+*/
+static u_int64 memAddrOf(volatile const u_int64 *p)
+{
+  const u_int32 lo = (u_int32)(size_t)p;  //lint !e9078 the address is the pattern
+  const u_int32 hi = lo + 4u;             // address of the second half
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return(((u_int64)lo << 32) | (u_int64)hi);
+#else
+  return(((u_int64)hi << 32) | (u_int64)lo);
+#endif
+}
+
+// address in address, then its inverse
+static bool memAddr(memStripe_t *msp)
+{
+  volatile u_int64 *p;
+  size_t  n;
+  u_int64 val,want,inv;
+
+  for(inv = 0u;inv <= 1u;inv++)
+  {
+    for(p = msp->base,n = msp->words;n != 0u;n--,p++)
+    {
+      *p = memAddrOf(p) ^ (0u - inv);
+    }
+
+    for(p = msp->base,n = msp->words;n != 0u;n--,p++)
+    {
+      want = memAddrOf(p) ^ (0u - inv);
+      val = *p;
+      if(val != want)
+      {
+        return(memBad(msp,p,want,val));
+      }
+    }
+  }
+
+  return(true);
+}
+
+// 0xaa and 0x55 in alternate words, then inverted
+static bool memChecker(memStripe_t *msp)
+{
+  volatile u_int64 *p;
+  size_t  i;
+  u_int64 val,want,inv;
+
+  for(inv = 0u;inv <= 1u;inv++)
+  {
+    for(p = msp->base,i = 0u;i < msp->words;i++,p++)
+    {
+      *p = (((i & 1u) != 0u) ? MEM_FILL(0x55u) : MEM_FILL(0xaau)) ^ (0u - inv);
+    }
+
+    for(p = msp->base,i = 0u;i < msp->words;i++,p++)
+    {
+      want = (((i & 1u) != 0u) ? MEM_FILL(0x55u) : MEM_FILL(0xaau)) ^ (0u - inv);
+      val = *p;
+      if(val != want)
+      {
+        return(memBad(msp,p,want,val));
+      }
+    }
+  }
+
+  return(true);
+}
+
+/*
+* Random words from -s, regenerated for the check, then inverted. Each
+* stripe mixes its address into the seed.
+*/
+static u_int64 memRand(u_int64 *sp)
+{
+  u_int64 x = *sp;
+
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *sp = x;
+  return(x);
+}
+
+static bool memRandom(memStripe_t *msp)
+{
+  const u_int64 seed = (memSeed ^ ((u_int64)(size_t)msp->base * 0x9e3779b97f4a7c15ULL)) | 1u; //lint !e9078
+  volatile u_int64 *p;
+  size_t  n;
+  u_int64 s,val,want,inv;
+
+  for(inv = 0u;inv <= 1u;inv++)
+  {
+    s = seed;
+    for(p = msp->base,n = msp->words;n != 0u;n--,p++)
+    {
+      *p = memRand(&s) ^ (0u - inv);
+    }
+
+    s = seed;
+    for(p = msp->base,n = msp->words;n != 0u;n--,p++)
+    {
+      want = memRand(&s) ^ (0u - inv);
+      val = *p;
+      if(val != want)
+      {
+        return(memBad(msp,p,want,val));
+      }
+    }
+  }
+
+  return(true);
+}
+
+static bool memMarch(memStripe_t *msp)
+{
+  const memMarch_t *mp = msp->pat->march;
+  const memElem_t  *ep;
+  volatile u_int64 *p;
+  size_t  n;
+  u_int8  i,k;
+  u_int64 val,want;
+
+  for(i = 0u;i < mp->n;i++)
+  {
+    ep = &mp->e[i];
+
+    for(n = msp->words;n != 0u;n--)
+    {
+      p = &msp->base[(ep->dir > 0) ? (msp->words - n) : (n - 1u)];
+
+      for(k = 0u;k < ep->n;k++)
+      {
+        switch (ep->op[k])
+        {
+          case mR0:
+          case mR1:
+            want = (ep->op[k] == (u_int8)mR0) ? 0u : MEM_ONES;
+            val = *p;
+            if(val != want)
+            {
+              return(memBad(msp,p,want,val));
+            }
+            break;
+          case mW0:
+            *p = 0u;
+            break;
+          default:
+            *p = MEM_ONES;
+            break;
+        }
+      }
+    }
+  }
+
+  return(true);
+}
+
+// {(w0); up(r0,w1); down(r1,w0)}
+static const memMarch_t memMatsPlus = {3u,{
+  {1,1u,{mW0}},{1,2u,{mR0,mW1}},{-1,2u,{mR1,mW0}}}};
+
+// {(w0); up(r0,w1); up(r1,w0); down(r0,w1); down(r1,w0); (r0)}
+static const memMarch_t memMarchCm = {6u,{
+  {1,1u,{mW0}},{1,2u,{mR0,mW1}},{1,2u,{mR1,mW0}},
+  {-1,2u,{mR0,mW1}},{-1,2u,{mR1,mW0}},{1,1u,{mR0}}}};
+
+// {(w0); up(r0,w1,r1,w0,r0,w1); up(r1,w0,w1); down(r1,w0,w1,w0); down(r0,w1,w0)}
+static const memMarch_t memMarchB = {5u,{
+  {1,1u,{mW0}},{1,6u,{mR0,mW1,mR1,mW0,mR0,mW1}},{1,3u,{mR1,mW0,mW1}},
+  {-1,4u,{mR1,mW0,mW1,mW0}},{-1,3u,{mR0,mW1,mW0}}}};
+
+static const memPat_t memPats[] = {
+  {"walk",   "walking 1's",        memWalk,   NULL,         128u,true},
+  {"or",     "0xaa|0x55=>0xff",    memOr,     NULL,           4u,true},
+  {"movinv", "moving inversions",  memMovInv, NULL,          10u,true},
+  {"addr",   "address in address", memAddr,   NULL,           4u,true},
+  {"mats",   "MATS+",              memMarch,  &memMatsPlus,   5u,false},
+  {"marchc", "March C-",           memMarch,  &memMarchCm,   10u,false},
+  {"marchb", "March B",            memMarch,  &memMarchB,    17u,false},
+  {"checker","checkerboard",       memChecker,NULL,           4u,false},
+  {"random", "random",             memRandom, NULL,           4u,false},
+  {NULL,NULL,NULL,NULL,0u,false}
+};
+
+static u_int32 memSel; // memPats bits selected by -p
+
+/*
+* Select the patterns in a comma separated list, "all" for every one
+*/
+static bool memSelect(const char *list)
+{
+  char    buf[128];
+  char   *tok,*save = NULL;
+  u_int32 i;
+  bool    found;
+
+  (void) strncpy(buf,list,sizeof(buf) - 1u);
+  buf[sizeof(buf) - 1u] = '\0';
+  memSel = 0u;
+
+  for(tok = strtok_r(buf,",",&save);tok != NULL;tok = strtok_r(NULL,",",&save))
+  {
+    found = false;
+    for(i = 0u;memPats[i].key != NULL;i++)
+    {
+      if((strcmp(tok,"all") == 0) || (strcmp(tok,memPats[i].key) == 0))
+      {
+        memSel |= 1uL << i;
+        found = true;
+      }
+    }
+
+    if(!found)
+    {
+      fitPrint(ERROR, "unknown pattern %s\n",tok);
+      return(false);
+    }
+  }
+
+  return(memSel != 0u);
+}
+
+static void *memWorker(void *vp)
+{
+  memStripe_t *msp = vp;
+
+  (void) msp->pat->kernel(msp);
+  return(NULL);
+}
+
+static u_int32 mptest(void *vp,size_t sz,u_int32 nThreads)
+{
+  const size_t line = FT_CACHE_LINE / sizeof(u_int64); // words per cache line
+  const size_t words = sz / sizeof(u_int64);
+  const size_t per = ((words / nThreads) / line) * line;
+  const memPat_t *pp;
+  memStripe_t *msp;
+  struct timespec start,end;
+  u_int32 i,started,fails = 0u;
+  float64 secs;
+
+  for(i = 0u;i < nThreads;i++)
+  {
+    msp = &memStripe[i];
+    msp->base = &((volatile u_int64 *)vp)[i * per];
+    msp->words = (i == (nThreads - 1u)) ? (words - (i * per)) : per; // the last takes the rest
+  }
+
+  for(pp = memPats;pp->name != NULL;pp++)
+  {
+    if((memSel & (1uL << (u_int32)(pp - memPats))) == 0u)
+    {
+      continue;
+    }
+
+    (void) clock_gettime(CLOCK_MONOTONIC,&start);
+
+    for(started = 0u;started < nThreads;started++)
+    {
+      msp = &memStripe[started];
+      msp->pat = pp;
+      msp->badp = NULL;
+      if(pthread_create(&msp->tid,NULL,memWorker,msp) != 0)
+      {
+        break;
+      }
+    }
+
+    for(i = started;i < nThreads;i++) // no thread for it, test it here
+    {
+      memStripe[i].pat = pp;
+      memStripe[i].badp = NULL;
+      (void) memWorker(&memStripe[i]);
+    }
+
+    for(i = 0u;i < started;i++)
+    {
+      (void) pthread_join(memStripe[i].tid,NULL);
+    }
+
+    (void) clock_gettime(CLOCK_MONOTONIC,&end);
+    secs = (float64)(end.tv_sec - start.tv_sec) + ((float64)(end.tv_nsec - start.tv_nsec) * 1.0e-9);
+
+    fitPrint(VERBOSE, "%-18s %lu threads (%lu started), %lu MB in %.3f s, %.3f GB/S\n",
+             pp->name,nThreads,started,(u_int32)(sz >> 20),secs,
+             ((float64)sz * (float64)pp->accesses) / (secs * 1.0e9));
+
+    if(pp->kernel == memRandom)
+    {
+      fitPrint(VERBOSE, "%-18s seed %llu\n",pp->name,memSeed);
+    }
+
+    for(i = 0u;i < nThreads;i++)
+    {
+      msp = &memStripe[i];
+      if(msp->badp != NULL)
+      {
+        memReport(pp->name,msp->badp,sizeof(u_int64),msp->expect,msp->actual);
+        fails++;
+      }
+    }
+  }
+
+  return(fails);
+}
+
 static u_int32 smtest(const char *sm)
 {
   int32   smFd;
@@ -404,16 +892,85 @@ ftRet_t memoryFit(plint argc,char * const argv[])
   const char  *smnt;         // SRAM mount point (/dev/sram)
   const char  *mounts = "/proc/mounts";
   struct mntent mnt_info = {NULL,NULL,NULL,NULL,0,0}; // SRAM mount information
+  int32   c;
+  int32   nThreads = -1;     // -j, classic heap test by default
+  bool    help = false;
+  u_int32 i;
+
+  memSeed = 1u;
+  memSel = 0u;
+  for(i = 0u;memPats[i].key != NULL;i++)
+  {
+    memSel |= memPats[i].dflt ? (1uL << i) : 0u;
+  }
+
+  opterr = 0;
+  while((c = getopt(argc,argv,"j:p:s:h")) != -1)
+  {
+    switch ((char)c)
+    {
+      case 'j': // parallel heap test threads
+        nThreads = strtol(optarg,NULL,10);
+        break;
+      case 'p': // heap test patterns
+        help = !memSelect(optarg);
+        nThreads = (nThreads < 0) ? 1 : nThreads;
+        break;
+      case 's': // random pattern seed
+        memSeed = strtoull(optarg,NULL,0);
+        break;
+      default:
+        if ((char)c != 'h')
+        {
+          if(isprint(optopt))
+          {
+            fitPrint(ERROR, "unknown option `-%c`.\n",optopt);
+          }
+          else
+          {
+            fitPrint(ERROR, "unknown option character `\\x%X`.\n",optopt);
+          }
+        }
+        help = true;
+        break;
+    }
+  }
 
-  if (argc > 1)
+  ftArgsDone();
+
+  if(help)
   {
-    fitPrint(USER, "Usage: %s\nOptions: none are permitted.\n",argv[0]);
+    fitPrint(USER, "Usage: %s [j[threads]p[patterns]s[seed]h]\n",argv[0]);
     fitPrint(USER, "Tests DRAM with global, stack and heap allocations.\n");
-    fitPrint(USER, "Tests SRAM via file system.\n\n");
+    fitPrint(USER, "Tests SRAM via file system.\n");
+    fitPrint(USER, "\t-j tests the heap block with this many threads at once, each on\n");
+    fitPrint(USER, "\t   its own cache line aligned stripe, 0 for one per online CPU.\n");
+    fitPrint(USER, "\t   The patterns stream 64-bit words at full speed, reported in\n");
+    fitPrint(USER, "\t   GB/S. Without -j or -p the heap is tested like the stack and\n");
+    fitPrint(USER, "\t   data, deliberately slowly.\n");
+    fitPrint(USER, "\t-p comma separated heap test patterns, one thread unless -j:\n");
+    for(i = 0u;memPats[i].key != NULL;i++)
+    {
+      fitPrint(USER, "\t     %-8s %s%s\n",memPats[i].key,memPats[i].name,
+               memPats[i].dflt ? ", by default" : "");
+    }
+    fitPrint(USER, "\t     all      every one of them\n");
+    fitPrint(USER, "\t-s seed of the random pattern, 1 by default\n");
+    fitPrint(USER, "\tA failing word is reported with its address, the value read,\n");
+    fitPrint(USER, "\tthe value expected and the failing bits.\n\n");
     fitLicense();
     return(ftComplete);
   }
 
+  if(nThreads == 0)
+  {
+    nThreads = (int32)sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if(nThreads > 0)
+  {
+    nThreads = MIN(nThreads,(int32)MEM_THREADS_MAX);
+  }
+
   fitPrint(VERBOSE, "testing stack memory\n");
   result = dmtest(sdat,sizeof(sdat));
 
@@ -438,7 +995,14 @@ ftRet_t memoryFit(plint argc,char * const argv[])
     ftUpdateTestStatus(ftrp,ftPass,NULL);
   }
 
-  mp = malloc(0x2000000u);
+  if(nThreads > 0)
+  {
+    mp = (posix_memalign(&mp,FT_CACHE_LINE,MEM_HEAP_SZ) == 0) ? mp : NULL;
+  }
+  else
+  {
+    mp = malloc(MEM_HEAP_SZ);
+  }
 
   if(mp == NULL)
   {
@@ -448,7 +1012,7 @@ ftRet_t memoryFit(plint argc,char * const argv[])
   else
   {
     fitPrint(VERBOSE, "testing heap memory\n");
-    result = dmtest(mp,0x2000000u);
+    result = (nThreads > 0) ? mptest(mp,MEM_HEAP_SZ,(u_int32)nThreads) : dmtest(mp,MEM_HEAP_SZ);
     if(result != 0u)
     {
       fitPrint(VERBOSE, "heap memory test failed\n");
@@ -34,6 +34,7 @@
 #include <semaphore.h>
 #include <string.h>
 #include <termios.h>
+#include <poll.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -47,8 +48,10 @@
 #define COMSZ  32 // byte count
 #define MAX_COMM_SZ 1024u
 #define DEV_NAME_SZ 32
-#define TXDEV "/dev/sp8"
-#define RXDEV "/dev/sp8"
+#define TXDEV "sp8"
+#define RXDEV "sp8"
+#define ECHO_LINES   16u  // configuration lines served by the echo server
+#define ECHO_POLL_MS 100  // how often the echo server checks the time
 
 typedef struct _comm_t
 {
@@ -72,6 +75,29 @@ static bool  flowControlFlag = false; // default flow control to disabled
 static spProt_t spProtocol = protNone;
 static speed_t  spBaudRate = 0;
 
+/*
+* One configuration line of the echo server, see -e
+*/
+typedef struct _echoLine
+{
+  char     devName_r[DEV_NAME_SZ];
+  char     devName_w[DEV_NAME_SZ];
+  int32    fd_r, fd_w;
+  u_char   buf[MAX_COMM_SZ];  // received, not echoed yet
+  size_t   off, len;          // bytes of buf echoed and received
+  float64  bytes;             // bytes echoed
+  u_int32  bursts;            // arrivals on an idle line
+  u_int32  errors;            // failed reads and writes
+  bool     waiting;           // everything is echoed, waiting for the far end
+  struct timespec echoed;     // when the last byte was echoed
+  float64  rttSum, rttMin, rttMax; // echo to the next arrival, seconds
+  u_int32  rttN;
+} echoLine_t;
+
+static echoLine_t echoLine[ECHO_LINES];
+static u_int32    echoLines = 0u;
+static u_int32    echoRate = 0u; // -b as given, 0 for the protocol default
+
 static ftRet_t rxTypeTwo (char *rx_name,int32 fd_rx,u_char *rx_ucp,
                           char *tx_name,u_char *tx_ucp,size_t sz)
 {
@@ -175,45 +201,352 @@ eagain2:
   return(ftRxError);
 }
 
-static speed_t mapBaudTermios(u_int32 baud)
+static float64 echoSecs(const struct timespec *a,const struct timespec *b)
+{
+  return((float64)(b->tv_sec - a->tv_sec) + ((float64)(b->tv_nsec - a->tv_nsec) * 1.0e-9));
+}
+
+/*
+* Open a port for the echo server, once for all lines that name it
+*/
+static int32 echoOpen(const char *name)
 {
-  speed_t ret;
+  u_int32 i;
+  int32   fd;
+  bool    sync = (strlen(name) == 4u); // sp[12358]s
+  speed_t baud;
 
-  switch(baud)
+  for(i=0;i < echoLines;i++)
   {
-    case 1200:
-      ret = (B1200);
-      break;
-    case 2400:
-      ret = (B2400);
-      break;
-    case 4800:
-      ret = (B4800);
-      break;
-    case 9600:
-      ret = (B9600);
-      break;
-    case 19200:
-      ret = (B19200);
-      break;
-    case 38400:
-      ret = (B38400);
-      break;
-    case 57600:
-      ret = (B57600);
-      break;
-    case 115200:
-      ret = (B115200);
-      break;
-    default:
-      // 153600 sdlc
-      // 614400 sdlc
-      ret = ((speed_t)baud);
-      break;
+    if((echoLine[i].fd_r != -1) && (strcmp(echoLine[i].devName_r,name) == 0))
+    {
+      return(echoLine[i].fd_r);
+    }
+    if((echoLine[i].fd_w != -1) && (strcmp(echoLine[i].devName_w,name) == 0))
+    {
+      return(echoLine[i].fd_w);
+    }
+  }
+
+  fd = spOpen(name,O_RDWR | O_NONBLOCK);
+  if(fd == -1)
+  {
+    fitPrint(ERROR, "%s: cannot open %s, err %d, %s\n",
+             __func__,name,errno,strerror(errno));
+    return(-1);
+  }
+
+  if(sync)
+  {
+    baud = (echoRate != 0u) ? echoRate : 153600;
+  }
+  else
+  {
+    baud = mapBaudTermios((echoRate != 0u) ? echoRate : 115200);
+  }
+
+  initSerialPort(fd,baud,sync ? protSync : protAsync,flowControlFlag);
+  return(fd);
+}
+
+/*
+* Close the ports of the echo server, each once
+*/
+static void echoClose(void)
+{
+  u_int32 i,j;
+  int32   fd;
+
+  for(i=0;i < (2u * echoLines);i++)
+  {
+    fd = ((i & 1u) == 0u) ? echoLine[i / 2u].fd_r : echoLine[i / 2u].fd_w;
+    if(fd == -1)
+    {
+      continue;
+    }
+
+    close(fd);
+
+    for(j=0;j < echoLines;j++)
+    {
+      echoLine[j].fd_r = (echoLine[j].fd_r == fd) ? -1 : echoLine[j].fd_r;
+      echoLine[j].fd_w = (echoLine[j].fd_w == fd) ? -1 : echoLine[j].fd_w;
+    }
+  }
+}
+
+/*
+* Next line of the configuration file that is neither a comment nor empty
+*/
+static const char *echoCfgLine(FILE *fp, char *buf, size_t len)
+{
+  const char *cp;
+
+  while(fgets(buf,(int32)len,fp) != NULL)
+  {
+    cp = &buf[strspn(buf," \t")];
+    if((*cp != '#') && (*cp != '\n') && (*cp != '\0'))
+    {
+      return(cp);
+    }
+  }
+
+  return(NULL);
+}
+
+/*
+* Read every line of the configuration file and open its ports
+*/
+static int32 echoConfig(const char *fn)
+{
+  echoLine_t *lp;
+  FILE   *fp;
+  char    buf[MUST_BE_BIG_ENOUGH];
+  const char *cp;
+  char    lcl_devName_r[DEV_NAME_SZ],lcl_devName_w[DEV_NAME_SZ];
+  int32   unused_min_size;
+  u_int32 unused_size,unused_iter,i;
+
+  fp = fopen(fn,"r");
+  if(fp == NULL)
+  {
+    fitPrint(ERROR, "cannot open config file %s\n",fn);
+    return(-1);
+  }
+
+  echoLines = 0u;
+
+  while((cp = echoCfgLine(fp,buf,sizeof(buf))) != NULL)
+  {
+    if(sscanf(cp,"%31s %31s %ld %lu %lu",lcl_devName_r,lcl_devName_w,
+              &unused_min_size,&unused_size,&unused_iter) != 5)
+    {
+      fitPrint(ERROR, "warning: %s: cannot parse %s",fn,cp);
+      continue;
+    }
+
+    for(i=0;i < echoLines;i++)
+    {
+      if(strcmp(echoLine[i].devName_r,lcl_devName_r) == 0)
+      {
+        break;
+      }
+    }
+
+    if(i < echoLines)
+    {
+      fitPrint(ERROR, "warning: %s already echoes, line ignored\n",lcl_devName_r);
+      continue;
+    }
+
+    if(echoLines == ECHO_LINES)
+    {
+      fitPrint(ERROR, "warning: more than %u lines, %s ignored\n",ECHO_LINES,lcl_devName_r);
+      continue;
+    }
+
+    lp = &echoLine[echoLines++];
+    memset(lp,0,sizeof(*lp));
+    strcpy(lp->devName_r,lcl_devName_r);
+    strcpy(lp->devName_w,lcl_devName_w);
+    lp->fd_r = -1;
+    lp->fd_w = -1;
+  }
+
+  fclose(fp);
+
+  /*
+  * Open special devices
+  */
+  for(i=0;i < echoLines;i++)
+  {
+    echoLine[i].fd_r = echoOpen(echoLine[i].devName_r);
+    echoLine[i].fd_w = echoOpen(echoLine[i].devName_w);
+
+    if((echoLine[i].fd_r == -1) || (echoLine[i].fd_w == -1))
+    {
+      return(-1);
+    }
+  }
+
+  return((echoLines != 0u) ? 0 : -1);
+}
+
+/*
+* Echo what a line has buffered, as much as its transmitter takes
+*/
+static void echoSend(echoLine_t *lp)
+{
+  ssize_t bCnt;
+
+  bCnt = write(lp->fd_w,&lp->buf[lp->off],lp->len - lp->off);
+
+  if(bCnt > 0)
+  {
+    lp->off += (size_t)bCnt;
+    lp->bytes += (float64)bCnt;
+  }
+  else if((bCnt == -1) && (errno != EAGAIN) && (errno != EINTR))
+  {
+    fitPrint(VERBOSE, "cannot write to %s, err %d, %s\n",lp->devName_w,errno,strerror(errno));
+    lp->errors++;
+    lp->off = lp->len; // drop it, the far end resends
+  }
+
+  if(lp->off == lp->len)
+  {
+    lp->off = 0u;
+    lp->len = 0u;
+    lp->waiting = true;
+    clock_gettime(CLOCK_MONOTONIC,&lp->echoed);
+  }
+}
+
+/*
+* Take what arrived on a line
+*/
+static void echoReceive(echoLine_t *lp)
+{
+  struct timespec now;
+  ssize_t bCnt;
+  float64 rtt;
+
+  bCnt = read(lp->fd_r,&lp->buf[lp->len],sizeof(lp->buf) - lp->len);
+
+  if(bCnt > 0)
+  {
+    if(lp->len == 0u)
+    {
+      lp->bursts++;
+      if(lp->waiting)
+      {
+        clock_gettime(CLOCK_MONOTONIC,&now);
+        rtt = echoSecs(&lp->echoed,&now);
+        lp->rttSum += rtt;
+        lp->rttMin = ((lp->rttN == 0u) || (rtt < lp->rttMin)) ? rtt : lp->rttMin;
+        lp->rttMax = (rtt > lp->rttMax) ? rtt : lp->rttMax;
+        lp->rttN++;
+      }
+    }
+    lp->waiting = false;
+    lp->len += (size_t)bCnt;
+    echoSend(lp); // most of the time the transmitter takes it right away
+  }
+  else if((bCnt == -1) && (errno != EAGAIN) && (errno != EINTR))
+  {
+    fitPrint(VERBOSE, "cannot read from %s, err %d, %s\n",lp->devName_r,errno,strerror(errno));
+    lp->errors++;
   }
-  return ret;
 }
 
+static void echoStats(float64 secs)
+{
+  const echoLine_t *lp;
+  u_int32 i;
+
+  for(i=0;i < echoLines;i++)
+  {
+    lp = &echoLine[i];
+    fitPrint(VERBOSE, "%s->%s %10.0f bytes %8lu bursts %10.1f B/S round trip avg %8.0f min %8.0f max %8.0f US %lu errors\n",
+             lp->devName_r,lp->devName_w,lp->bytes,lp->bursts,
+             (secs > 0.0) ? (lp->bytes / secs) : 0.0,
+             (lp->rttN != 0u) ? ((lp->rttSum / (float64)lp->rttN) * 1.0e6) : 0.0,
+             lp->rttMin * 1.0e6,lp->rttMax * 1.0e6,lp->errors);
+  }
+}
+
+/*
+*
+* Echo server
+*
+* Every configuration line echoes what arrives on its receive port out of
+* its transmit port, all lines from one poll() loop. A line keeps what its
+* transmitter did not take yet and stops reading while that buffer is
+* full, so a slow port only holds back its own line. The round trip is
+* measured from the last byte echoed to the next arrival on that line.
+*
+*/
+static ftRet_t echoServe(const char *fn,u_int32 duration)
+{
+  struct pollfd pfd[2u * ECHO_LINES];
+  struct timespec start,now,report;
+  echoLine_t *lp;
+  ftRecord_t rec;
+  u_int32 i;
+  int32   n;
+
+  if(echoConfig(fn) != 0)
+  {
+    echoClose();
+    ftUpdateTestStatus(ftrp,ftError,NULL);
+    return(ftUpdateTestStatus(ftrp,ftComplete,NULL));
+  }
+
+  fitPrint(VERBOSE, "echoing on %lu lines for %lu seconds (0 until interrupted)\n",
+           echoLines,duration);
+
+  clock_gettime(CLOCK_MONOTONIC,&start);
+  report = start;
+  now = start;
+
+  while(keepGoing && ((duration == 0u) || (echoSecs(&start,&now) < (float64)duration)))
+  {
+    for(i=0;i < echoLines;i++)
+    {
+      lp = &echoLine[i];
+      pfd[2u * i].fd = lp->fd_r;
+      pfd[2u * i].events = (lp->len < sizeof(lp->buf)) ? POLLIN : 0;
+      pfd[(2u * i) + 1u].fd = lp->fd_w;
+      pfd[(2u * i) + 1u].events = (lp->off < lp->len) ? POLLOUT : 0;
+    }
+
+    n = poll(pfd,2u * echoLines,ECHO_POLL_MS);
+
+    for(i=0;(n > 0) && (i < echoLines);i++)
+    {
+      lp = &echoLine[i];
+      if((pfd[(2u * i) + 1u].revents & POLLOUT) != 0)
+      {
+        echoSend(lp);
+      }
+      if((pfd[2u * i].revents & (POLLIN | POLLERR | POLLHUP)) != 0)
+      {
+        echoReceive(lp);
+      }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    if(echoSecs(&report,&now) >= (float64)RXTMO)
+    {
+      echoStats(echoSecs(&start,&now));
+      report = now;
+    }
+  }
+
+  echoStats(echoSecs(&start,&now));
+
+  for(i=0;i < echoLines;i++)
+  {
+    lp = &echoLine[i];
+
+    memset(&rec,0,sizeof(rec));
+    rec.event  = "echo";
+    rec.rx     = lp->devName_r;
+    rec.tx     = lp->devName_w;
+    rec.result = (lp->errors != 0u) ? ftFail : ((lp->bursts == 0u) ? ftRxTimeout : ftPass);
+    rec.okCnt  = lp->bursts;
+    rec.ngCnt  = lp->errors;
+    rec.start  = start;
+    rec.end    = now;
+    ftRecord(&rec); // per line summary, see fit -R
+
+    ftUpdateTestStatus(ftrp,rec.result,lp->devName_r);
+  }
+
+  echoClose();
+
+  return(ftUpdateTestStatus(ftrp,ftComplete,NULL));
+}
 
 static void usage(char * cp)
 {
@@ -236,7 +569,8 @@ A typical file might look like:\n\
 \n\
 sp2 sp1 1 32 10\n\
 \n\
-A single line is scanned. The test executes in a single user space process.\n\
+A single line is scanned, lines starting with # and empty lines are skipped.\n\
+The test executes in a single user space process.\n\
 In this case, a single packet of size 32 bytes is transmitted from serial\n\
 port 1 to serial port 2. Upon successful reception at serial port 2, the\n\
 packet is then turned around and re-transmitted from serial port 2 to\n\
@@ -249,10 +583,16 @@ The arguments and functionality are defined as:\n\
 \t   to 115200\n\
 \t   and synchronous ports will default to 153600 baud.\n\
 \t-i specifies the number of overall test iterations.\n\
+\t-e echo server for this many seconds, 0 until interrupted. Every line of\n\
+\t   the configuration file is served at once: whatever arrives on the\n\
+\t   receive port is sent back out of the transmit port, so one controller\n\
+\t   is the far end of the serial tests of another. Bytes, bursts,\n\
+\t   throughput and the round trip from an echo to the next arrival are\n\
+\t   reported per line every 10 seconds.\n\
 \t-c configuration file name\n\
 \t-h this help\n\
 ";
-  fitPrint(USER,  "usage: %s [fb[baud rate]i[iteration]c[config file]h]\n%s\n",cp,us);
+  fitPrint(USER,  "usage: %s [fb[baud rate]i[iteration]e[seconds]c[config file]h]\n%s\n",cp,us);
   fitLicense();
   exit(0);
 }
@@ -265,6 +605,11 @@ ftRet_t serialEchoFit(plint argc, char * const argv[])
   ftRet_t  ftResult;
   char lcl_devName_r[DEV_NAME_SZ],lcl_devName_w[DEV_NAME_SZ];
   FILE *fp;
+  char buf[MUST_BE_BIG_ENOUGH];
+  const char *cp;
+  const char *cfgName = NULL;
+  bool     echoMode = false;
+  u_int32  echoDuration = 0u;
 
   /*
   * Set defaults
@@ -274,12 +619,16 @@ ftRet_t serialEchoFit(plint argc, char * const argv[])
   strcpy(commp->devName_w,TXDEV);
   commp->comSz = COMSZ;
   commp->iter = TXNUM;
+  echoRate = 0u;
+  flowControlFlag = false;
+  spProtocol = protNone;
+  spBaudRate = 0;
 
   /*
   * Parse command line arguments
   */
   opterr = 0;
-  c = getopt(argc,argv,"fc:i:b:h");
+  c = getopt(argc,argv,"fc:i:b:e:h");
 
   while(c != -1)
   {
@@ -300,6 +649,7 @@ ftRet_t serialEchoFit(plint argc, char * const argv[])
         usage(argv[0]);
         break;
       case 'c': // configuration file name
+        cfgName = optarg;
         fp = fopen(optarg,"r");
         if(fp == NULL)
         {
@@ -308,8 +658,16 @@ ftRet_t serialEchoFit(plint argc, char * const argv[])
           return(ftUpdateTestStatus(ftrp,ftComplete,NULL));
         }
 
-        fscanf(fp,"%s %s %ld %u %lu",
-               lcl_devName_r,lcl_devName_w,&unused_min_size,&commp->comSz,&commp->iter);
+        cp = echoCfgLine(fp,buf,sizeof(buf));
+        if((cp == NULL) ||
+           (sscanf(cp,"%31s %31s %ld %u %lu",lcl_devName_r,lcl_devName_w,
+                   &unused_min_size,&commp->comSz,&commp->iter) != 5))
+        {
+          fitPrint(ERROR, "cannot parse config file %s\n",optarg);
+          fclose(fp);
+          ftUpdateTestStatus(ftrp,ftError,NULL);
+          return(ftUpdateTestStatus(ftrp,ftComplete,NULL));
+        }
 
         if(strlen(lcl_devName_r) == 4u)
         { // sp[12358]s
@@ -330,11 +688,8 @@ ftRet_t serialEchoFit(plint argc, char * const argv[])
           }
         }
 
-        strcpy(commp->devName_r,"/dev/");
-        strcat(commp->devName_r,lcl_devName_r);
-
-        strcpy(commp->devName_w,"/dev/");
-        strcat(commp->devName_w,lcl_devName_w);
+        strcpy(commp->devName_r,lcl_devName_r);
+        strcpy(commp->devName_w,lcl_devName_w);
 
         if (commp->comSz > MAX_COMM_SZ)
         {
@@ -349,7 +704,12 @@ ftRet_t serialEchoFit(plint argc, char * const argv[])
       case 'f': // enable flow control
         flowControlFlag = true;
         break;
+      case 'e': // echo server for this many seconds
+        echoMode = true;
+        echoDuration = strtoul(optarg,NULL,10);
+        break;
       case 'b': // run test at specified rate
+        echoRate = strtoul(optarg,NULL,10);
         spBaudRate = strtoul(optarg,NULL,10);
         if (spProtocol == protAsync)
         {
@@ -359,7 +719,7 @@ ftRet_t serialEchoFit(plint argc, char * const argv[])
 
     }
 
-    c = getopt(argc,argv,"fc:i:b:h");
+    c = getopt(argc,argv,"fc:i:b:e:h");
   }
 
   for(idx = optind; idx < argc; idx++)
@@ -368,12 +728,25 @@ ftRet_t serialEchoFit(plint argc, char * const argv[])
     usage(argv[0]);
   }
 
+  ftArgsDone();
+
+  if(echoMode)
+  {
+    if(cfgName == NULL)
+    {
+      fitPrint(ERROR, "-e needs a configuration file, see -c\n");
+      ftUpdateTestStatus(ftrp,ftError,NULL);
+      return(ftUpdateTestStatus(ftrp,ftComplete,NULL));
+    }
+    return(echoServe(cfgName,echoDuration));
+  }
+
   /*
   * Open special devices
   */
   if(strcmp(commp->devName_r,commp->devName_w) == 0)
   {
-    fd_w = open(commp->devName_w,O_RDWR);
+    fd_w = spOpen(commp->devName_w,O_RDWR);
 
     if(fd_w == -1)
     {
@@ -388,7 +761,7 @@ ftRet_t serialEchoFit(plint argc, char * const argv[])
   }
   else
   {
-    fd_w = open(commp->devName_w,O_RDWR);
+    fd_w = spOpen(commp->devName_w,O_RDWR);
 
     if(fd_w == -1)
     {
@@ -398,7 +771,7 @@ ftRet_t serialEchoFit(plint argc, char * const argv[])
       return(ftUpdateTestStatus(ftrp,ftComplete,commp->devName_w));
     }
 
-    fd_r = open(commp->devName_r,O_RDWR);
+    fd_r = spOpen(commp->devName_r,O_RDWR);
 
     if(fd_r == -1)
     {
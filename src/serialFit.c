@@ -38,6 +38,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
 
 #include "fit.h"
 #include "serialFit.h"
@@ -1197,435 +1198,78 @@ static void set_loopback_echo(void)
 
 // ====================== Start of Active Code =======================
 /*
-* SP1 ASYNC Baud Rate Data Initialization
+* Baud rates supported by the controller serial ports
 */
-static bRate_t sp1BR[] = { // asynchronous baud rates for sp1
-  {   B1200,0,0,0,0,NULL },
-  {   B2400,0,0,0,0,NULL },
-  {   B4800,0,0,0,0,NULL },
-  {   B9600,0,0,0,0,NULL },
-  {  B19200,0,0,0,0,NULL },
-  {  B38400,0,0,0,0,NULL },
-  {  B57600,0,0,0,0,NULL },
-  { B115200,0,0,0,0,NULL },
-  {       0,0,0,0,0,NULL },
-};
-
-static sem_t     mon1Mutex;              // test executor mutex
-static sem_t     sp1Mutex_r, sp1Mutex_w; // test thread mutexs
-static sem_t     sp1Lock;                // port locking mutex
-static pthread_t sp1Tid_r, sp1Tid_w;     // test thread IDs
-static char      sp1Buf_r[MAX_TRANSFER], sp1Buf_w[MAX_TRANSFER]; // COM buffers
-
-/*
-* SP1s SYNC Baud Rate Data Initialization
-*/
-static bRate_t sp1sBR[] = { // synchronous baud rates for sp1s
-  {  19200,0,0,0,0,NULL },
-  {  38400,0,0,0,0,NULL },
-  {  57600,0,0,0,0,NULL },
-  {  76800,0,0,0,0,NULL },
-  { 153600,0,0,0,0,NULL },
-  {      0,0,0,0,0,NULL },
-};
-
-static sem_t     mon1sMutex;               // test executor mutex
-static sem_t     sp1sMutex_r, sp1sMutex_w; // test thread mutexs
-static sem_t     sp1sLock;                 // port locking mutex
-static pthread_t sp1sTid_r, sp1sTid_w;     // test thread IDs
-static char      sp1sBuf_r[MAX_TRANSFER], sp1sBuf_w[MAX_TRANSFER]; // COM buffers
-
-/*
-* SP2 ASYNC Baud Rate Data Initialization
-*/
-static bRate_t sp2BR[] = { // asynchronous baud rates for sp2
-  {   B1200,0,0,0,0,NULL },
-  {   B2400,0,0,0,0,NULL },
-  {   B4800,0,0,0,0,NULL },
-  {   B9600,0,0,0,0,NULL },
-  {  B19200,0,0,0,0,NULL },
-  {  B38400,0,0,0,0,NULL },
-  {  B57600,0,0,0,0,NULL },
-  { B115200,0,0,0,0,NULL },
-  {       0,0,0,0,0,NULL },
-};
-
-static sem_t     mon2Mutex;              // test executor mutex
-static sem_t     sp2Mutex_r, sp2Mutex_w; // test thread mutexs
-static sem_t     sp2Lock;                // port locking mutex
-static pthread_t sp2Tid_r, sp2Tid_w;     // test thread IDs
-static char      sp2Buf_r[MAX_TRANSFER], sp2Buf_w[MAX_TRANSFER]; // COM buffers
-
-/*
-* SP2s SYNC Baud Rate Data Initialization
-*/
-static bRate_t sp2sBR[] = { // synchronous baud rates for sp2s
-  {  19200,0,0,0,0,NULL },
-  {  38400,0,0,0,0,NULL },
-  {  57600,0,0,0,0,NULL },
-  {  76800,0,0,0,0,NULL },
-  { 153600,0,0,0,0,NULL },
-  {      0,0,0,0,0,NULL },
-};
-
-static sem_t     mon2sMutex;               // test executor mutex
-static sem_t     sp2sMutex_r, sp2sMutex_w; // test thread mutexs
-static sem_t     sp2sLock;                 // port locking mutex
-static pthread_t sp2sTid_r, sp2sTid_w;     // test thread IDs
-static char      sp2sBuf_r[MAX_TRANSFER], sp2sBuf_w[MAX_TRANSFER]; // COM buffers
-
-/*
-* SP3 ASYNC Baud Rate Data Initialization
-*/
-static bRate_t sp3BR[] = { // asynchronous baud rates for sp3
-  {   B1200,0,0,0,0,NULL },
-  {   B2400,0,0,0,0,NULL },
-  {   B4800,0,0,0,0,NULL },
-  {   B9600,0,0,0,0,NULL },
-  {  B19200,0,0,0,0,NULL },
-  {  B38400,0,0,0,0,NULL },
-  {  B57600,0,0,0,0,NULL },
-  { B115200,0,0,0,0,NULL },
-  {       0,0,0,0,0,NULL },
-};
-
-static sem_t     mon3Mutex;              // test executor mutex
-static sem_t     sp3Mutex_r, sp3Mutex_w; // test thread mutexs
-static sem_t     sp3Lock;                // port locking mutex
-static pthread_t sp3Tid_r, sp3Tid_w;     // test thread IDs
-static char      sp3Buf_r[MAX_TRANSFER], sp3Buf_w[MAX_TRANSFER]; // COM buffers
-
-/*
-* SP3s SYNC Baud Rate Data Initialization
-*/
-static bRate_t sp3sBR[] = { // synchronous baud rates for sp3s
-  { 153600,0,0,0,0,NULL },
-  { 614400,0,0,0,0,NULL },
-  {      0,0,0,0,0,NULL },
-};
-
-static sem_t     mon3sMutex;               // test executor mutex
-static sem_t     sp3sMutex_r, sp3sMutex_w; // test thread mutexs
-static sem_t     sp3sLock;                 // port locking mutex
-static pthread_t sp3sTid_r, sp3sTid_w;     // test thread IDs
-static char      sp3sBuf_r[MAX_TRANSFER], sp3sBuf_w[MAX_TRANSFER]; // COM buffers
-
-/*
-* SP4 ASYNC Baud Rate Data Initialization
-*/
-static bRate_t sp4BR[] = { // asynchronous baud rates for sp4
-  {   B1200,0,0,0,0,NULL },
-  {   B2400,0,0,0,0,NULL },
-  {   B4800,0,0,0,0,NULL },
-  {   B9600,0,0,0,0,NULL },
-  {  B19200,0,0,0,0,NULL },
-  {  B38400,0,0,0,0,NULL },
-  {  B57600,0,0,0,0,NULL },
-  { B115200,0,0,0,0,NULL },
-  {       0,0,0,0,0,NULL },
-};
-
-static sem_t     mon4Mutex;              // test executor mutex
-static sem_t     sp4Mutex_r, sp4Mutex_w; // test thread mutexs
-static sem_t     sp4Lock;                // port locking mutex
-static pthread_t sp4Tid_r, sp4Tid_w;     // test thread IDs
-static char      sp4Buf_r[MAX_TRANSFER], sp4Buf_w[MAX_TRANSFER]; // COM buffers
+static const speed_t spAsyncRates[]  = { B1200,B2400,B4800,B9600,B19200,B38400,B57600,B115200,0 };
+static const speed_t spSyncRates[]   = { 19200,38400,57600,76800,153600,0 };
+static const speed_t spSyncHiRates[] = { 153600,614400,0 };
 
-/*
-* SP5s SYNC Baud Rate Data Initialization
-*/
-static bRate_t sp5sBR[] = { // synchronous baud rates for sp5s
-  { 153600,0,0,0,0,NULL },
-  { 614400,0,0,0,0,NULL },
-  {      0,0,0,0,0,NULL },
-};
-
-static sem_t     mon5sMutex;               // test executor mutex
-static sem_t     sp5sMutex_r, sp5sMutex_w; // test thread mutexs
-static sem_t     sp5sLock;                 // port locking mutex
-static pthread_t sp5sTid_r, sp5sTid_w;     // test thread IDs
-static char      sp5sBuf_r[MAX_TRANSFER], sp5sBuf_w[MAX_TRANSFER]; // COM buffers
-
-/*
-* SP6 ASYNC Baud Rate Data Initialization
-*/
-static bRate_t sp6BR[] = { // asynchronous baud rates for sp6
-  {   B1200,0,0,0,0,NULL },
-  {   B2400,0,0,0,0,NULL },
-  {   B4800,0,0,0,0,NULL },
-  {   B9600,0,0,0,0,NULL },
-  {  B19200,0,0,0,0,NULL },
-  {  B38400,0,0,0,0,NULL },
-  {  B57600,0,0,0,0,NULL },
-  { B115200,0,0,0,0,NULL },
-  {       0,0,0,0,0,NULL },
-};
-
-static sem_t     mon6Mutex;              // test executor mutex
-static sem_t     sp6Mutex_r, sp6Mutex_w; // test thread mutexs
-static sem_t     sp6Lock;                // port locking mutex
-static pthread_t sp6Tid_r, sp6Tid_w;     // test thread IDs
-static char      sp6Buf_r[MAX_TRANSFER], sp6Buf_w[MAX_TRANSFER]; // COM buffers
+#define SP_MAX_RATES 11u // see ATC_B[]
 
 /*
-* SP8 ASYNC Baud Rate Data Initialization
+* Serial port map, one line per special device
+*
+* Ports with a shared clock only support their two high rates. Between a
+* shared clock port and any other port, only 153600 can be used.
 */
-static bRate_t sp8BR[] = { // asynchronous baud rates for sp8
-  {   B1200,0,0,0,0,NULL },
-  {   B2400,0,0,0,0,NULL },
-  {   B4800,0,0,0,0,NULL },
-  {   B9600,0,0,0,0,NULL },
-  {  B19200,0,0,0,0,NULL },
-  {  B38400,0,0,0,0,NULL },
-  {  B57600,0,0,0,0,NULL },
-  { B115200,0,0,0,0,NULL },
-  {       0,0,0,0,0,NULL },
+typedef struct _spPort {
+  const char    *name;     // special device basename
+  spProt_t       protocol; // expected protocol
+  const speed_t *rates;    // zero terminated baud rates
+  bool           shared;   // clock shared with the other high rate ports
+} spPort_t;
+
+static const spPort_t spPorts[] = {
+  { "sp1",  protAsync, spAsyncRates,  false },
+  { "sp2",  protAsync, spAsyncRates,  false },
+  { "sp3",  protAsync, spAsyncRates,  false },
+  { "sp4",  protAsync, spAsyncRates,  false },
+  { "sp6",  protAsync, spAsyncRates,  false },
+  { "sp8",  protAsync, spAsyncRates,  false },
+  { "sp1s", protSync,  spSyncRates,   false },
+  { "sp2s", protSync,  spSyncRates,   false },
+  { "sp3s", protSync,  spSyncHiRates, true  },
+  { "sp5s", protSync,  spSyncHiRates, true  },
+  { "sp8s", protSync,  spSyncRates,   false },
+  { NULL,   protNone,  NULL,          false }
 };
 
-static sem_t     mon8Mutex;              // test executor mutex
-static sem_t     sp8Mutex_r, sp8Mutex_w; // test thread mutexs
-static sem_t     sp8Lock;                // port locking mutex
-static pthread_t sp8Tid_r, sp8Tid_w;     // test thread IDs
-static char      sp8Buf_r[MAX_TRANSFER], sp8Buf_w[MAX_TRANSFER]; // COM buffers
-
 /*
-* SP8s SYNC Baud Rate Data Initialization
+* Test descriptor, one contiguous allocation per configured port pair
 */
-static bRate_t sp8sBR[] = { // synchronous baud rates for sp8s
-  {  19200,0,0,0,0,NULL },
-  {  38400,0,0,0,0,NULL },
-  {  57600,0,0,0,0,NULL },
-  {  76800,0,0,0,0,NULL },
-  { 153600,0,0,0,0,NULL },
-//{ 614400,0,0,0,0,NULL },
-  {      0,0,0,0,0,NULL },
-};
-
-static sem_t     mon8sMutex;               // test executor mutex
-static sem_t     sp8sMutex_r, sp8sMutex_w; // test thread mutexs
-static sem_t     sp8sLock;                 // port locking mutex
-static pthread_t sp8sTid_r, sp8sTid_w;     // test thread IDs
-static char      sp8sBuf_r[MAX_TRANSFER], sp8sBuf_w[MAX_TRANSFER]; // COM buffers
+typedef struct _spDesc {
+  spDatDat_t dat;                     // must be first
+  sem_t      mon, sem_r, sem_w, lock; // monitor, thread and port locking semaphores
+  pthread_t  tid_r, tid_w;            // test thread IDs
+  bool       workers;                 // the threads are running, see spPool
+  bool       writer;                  // the transmitter thread is running, see spTxInline()
+  size_t     len;                     // of the whole allocation
+  bRate_t    br[SP_MAX_RATES + 1u];   // zero terminated, statistics per baud rate
+  char       buf_r[MAX_TRANSFER] __attribute__ ((aligned (FT_CACHE_LINE))); // COM buffers
+  char       buf_w[MAX_TRANSFER] __attribute__ ((aligned (FT_CACHE_LINE)));
+} spDesc_t;
+
+static spDatDat_t *spDatDat = NULL; // scheduled tests, see spConfigDat()
+static spDatDat_t *spPool = NULL;   // idle descriptors kept for the next invocation
+static bool        spPoolExit = false; // spPoolDrain() is registered
+
+static void spPoolDrain (void);
 
 /*
-* Initialized DAT Data
+* Intern a special device basename, returns its spPorts[] index or -1
 */
-static spDatDat_t spDatDat[] = {
-  /*
-  * Single asynchronous ports that are physically looped back to themselves.
-  */
-  { "AsyncExtLoopback","sp1","sp1",&mon1Mutex,&sp1Mutex_r,&sp1Mutex_w,&sp1Lock,
-    &sp1Tid_r,&sp1Tid_w,sp1Buf_r,sp1Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp1BR,NULL},
-
-  { "AsyncExtLoopback","sp2","sp2",&mon2Mutex,&sp2Mutex_r,&sp2Mutex_w,&sp2Lock,
-    &sp2Tid_r,&sp2Tid_w,sp2Buf_r,sp2Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp2BR,NULL},
-
-  { "AsyncExtLoopback","sp3","sp3",&mon3Mutex,&sp3Mutex_r,&sp3Mutex_w,&sp3Lock,
-    &sp3Tid_r,&sp3Tid_w,sp3Buf_r,sp3Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp3BR,NULL},
-
-  { "AsyncExtLoopback","sp4","sp4",&mon4Mutex,&sp4Mutex_r,&sp4Mutex_w,&sp4Lock,
-    &sp4Tid_r,&sp4Tid_w,sp4Buf_r,sp4Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp4BR,NULL},
-
-  { "AsyncExtLoopback","sp6","sp6",&mon6Mutex,&sp6Mutex_r,&sp6Mutex_w,&sp6Lock,
-    &sp6Tid_r,&sp6Tid_w,sp6Buf_r,sp6Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp6BR,NULL},
-
-  { "AsyncExtLoopback","sp8","sp8",&mon8Mutex,&sp8Mutex_r,&sp8Mutex_w,&sp8Lock,
-    &sp8Tid_r,&sp8Tid_w,sp8Buf_r,sp8Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp8BR,NULL},
-
-  /*
-  * Single synchronous ports that are physically looped back to themselves.
-  */
-  { "SyncExtLoopback","sp1s","sp1s",&mon1sMutex,&sp1sMutex_r,&sp1sMutex_w,
-    &sp1sLock,&sp1sTid_r,&sp1sTid_w, sp1sBuf_r,sp1sBuf_w,0,32,32,1,protSync,
-    -1,-1,unscheduled,unscheduled,sp1sBR,NULL},
-
-  { "SyncExtLoopback","sp2s","sp2s",&mon2sMutex,&sp2sMutex_r,&sp2sMutex_w,
-    &sp2sLock,&sp2sTid_r,&sp2sTid_w, sp2sBuf_r,sp2sBuf_w,0,32,32,1,protSync,
-    -1,-1,unscheduled,unscheduled,sp2sBR,NULL},
-
-  { "SyncExtLoopback","sp3s","sp3s",&mon3sMutex,&sp3sMutex_r,&sp3sMutex_w,
-    &sp3sLock,&sp3sTid_r,&sp3sTid_w,sp3sBuf_r,sp3sBuf_w,0,32,32,1,protSync,
-    -1,-1,unscheduled,unscheduled,sp3sBR,NULL},
-
-  { "SyncExtLoopback","sp5s","sp5s",&mon5sMutex,&sp5sMutex_r,&sp5sMutex_w,
-    &sp5sLock,&sp5sTid_r,&sp5sTid_w,sp5sBuf_r,sp5sBuf_w,0,32,32,1,protSync,
-    -1,-1,unscheduled,unscheduled,sp5sBR,NULL},
-
-  { "SyncExtLoopback","sp8s","sp8s",&mon8sMutex,&sp8sMutex_r,&sp8sMutex_w,
-    &sp8sLock,&sp8sTid_r,&sp8sTid_w,sp8sBuf_r,sp8sBuf_w,0,32,32,1,protSync,
-    -1,-1,unscheduled,unscheduled,sp8sBR,NULL},
-
-  /*
-  * This data defines sp1 cross-connected to sp2.
-  */
-  { "AsyncExtLoopback","sp1","sp2",&mon1Mutex,&sp1Mutex_r,&sp2Mutex_w,&sp1Lock,
-    &sp1Tid_r,&sp2Tid_w,sp1Buf_r,sp2Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp1BR,NULL},
-  { "AsyncExtLoopback","sp2","sp1",&mon2Mutex,&sp2Mutex_r,&sp1Mutex_w,&sp1Lock,
-    &sp2Tid_r,&sp1Tid_w,sp2Buf_r,sp1Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp2BR,NULL},
-
-  /*
-  * This data defines sp1 cross-connected to sp3.
-  */
-  { "AsyncExtLoopback","sp1","sp3",&mon1Mutex,&sp1Mutex_r,&sp3Mutex_w,&sp1Lock,
-    &sp1Tid_r,&sp3Tid_w,sp1Buf_r,sp3Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp1BR,NULL},
-  { "AsyncExtLoopback","sp3","sp1",&mon3Mutex,&sp3Mutex_r,&sp1Mutex_w,&sp1Lock,
-    &sp3Tid_r,&sp1Tid_w,sp3Buf_r,sp1Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp3BR,NULL},
-
-  /*
-  * This data defines sp1 cross-connected to sp8.
-  */
-  { "AsyncExtLoopback","sp1","sp8",&mon1Mutex,&sp1Mutex_r,&sp8Mutex_w,&sp1Lock,
-    &sp1Tid_r,&sp8Tid_w,sp1Buf_r,sp8Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp1BR,NULL},
-  { "AsyncExtLoopback","sp8","sp1",&mon8Mutex,&sp8Mutex_r,&sp1Mutex_w,&sp1Lock,
-    &sp8Tid_r,&sp1Tid_w,sp8Buf_r,sp1Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp8BR,NULL},
-
-  /*
-  * This data defines sp2 cross-connected to sp3.
-  */
-  { "AsyncExtLoopback","sp2","sp3",&mon2Mutex,&sp2Mutex_r,&sp3Mutex_w,&sp2Lock,
-    &sp2Tid_r,&sp3Tid_w,sp2Buf_r,sp3Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp2BR,NULL},
-  { "AsyncExtLoopback","sp3","sp2",&mon3Mutex,&sp3Mutex_r,&sp2Mutex_w,&sp2Lock,
-    &sp3Tid_r,&sp2Tid_w,sp3Buf_r,sp2Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp3BR,NULL},
-
-  /*
-  * This data defines sp2 cross-connected to sp8.
-  */
-  { "AsyncExtLoopback","sp2","sp8",&mon2Mutex,&sp2Mutex_r,&sp8Mutex_w,&sp2Lock,
-    &sp2Tid_r,&sp8Tid_w,sp2Buf_r,sp8Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp2BR,NULL},
-  { "AsyncExtLoopback","sp8","sp2",&mon8Mutex,&sp8Mutex_r,&sp2Mutex_w,&sp2Lock,
-    &sp8Tid_r,&sp2Tid_w,sp8Buf_r,sp2Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp8BR,NULL},
-
-  /*
-  * This data defines sp3 cross-connected to sp8.
-  */
-  { "AsyncExtLoopback","sp3","sp8",&mon3Mutex,&sp3Mutex_r,&sp8Mutex_w,&sp3Lock,
-    &sp3Tid_r,&sp8Tid_w,sp3Buf_r,sp8Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp3BR,NULL},
-  { "AsyncExtLoopback","sp8","sp3",&mon8Mutex,&sp8Mutex_r,&sp3Mutex_w,&sp3Lock,
-    &sp8Tid_r,&sp3Tid_w,sp8Buf_r,sp3Buf_w,0,32,32,1,protAsync,-1,-1,unscheduled,
-    unscheduled,sp8BR,NULL},
-
-
-  /*
-  * This data defines sp1s cross-connected to sp2s.
-  */
-  { "SyncExtLoopback","sp1s","sp2s",&mon1sMutex,&sp1sMutex_r,&sp2sMutex_w,&sp1sLock,&sp1sTid_r,&sp2sTid_w,
-  sp1sBuf_r,sp2sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,unscheduled,sp1sBR,NULL},
-  { "SyncExtLoopback","sp2s","sp1s",&mon2sMutex,&sp2sMutex_r,&sp1sMutex_w,&sp1sLock,&sp2sTid_r,&sp1sTid_w,
-  sp2sBuf_r,sp1sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,unscheduled,sp2sBR,NULL},
-
-  /*
-  * This data defines sp1s cross-connected to sp3s.
-  */
-  { "SyncExtLoopback","sp1s","sp3s",&mon1sMutex,&sp1sMutex_r,&sp3sMutex_w,&sp1sLock,
-    &sp1sTid_r,&sp3sTid_w,  sp1sBuf_r,sp3sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp1sBR,NULL},
-  { "SyncExtLoopback","sp3s","sp1s",&mon3sMutex,&sp3sMutex_r,&sp1sMutex_w,&sp1sLock,
-    &sp3sTid_r,&sp1sTid_w,sp3sBuf_r,sp1sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp3sBR,NULL},
-
-  /*
-  * This data defines sp1s cross-connected to sp5s.
-  */
-  { "SyncExtLoopback","sp1s","sp5s",&mon1sMutex,&sp1sMutex_r,&sp5sMutex_w,&sp1sLock,
-    &sp1sTid_r,&sp5sTid_w,sp1sBuf_r,sp5sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp1sBR,NULL},
-  { "SyncExtLoopback","sp5s","sp1s",&mon5sMutex,&sp5sMutex_r,&sp1sMutex_w,&sp1sLock,
-    &sp5sTid_r,&sp1sTid_w,sp5sBuf_r,sp1sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp5sBR,NULL},
-
-  /*
-  * This data defines sp1s cross-connected to sp8s.
-  */
-  { "SyncExtLoopback","sp1s","sp8s",&mon1sMutex,&sp1sMutex_r,&sp8sMutex_w,&sp1sLock,
-    &sp1sTid_r,&sp8sTid_w,sp1sBuf_r,sp8sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp1sBR,NULL},
-  { "SyncExtLoopback","sp8s","sp1s",&mon8sMutex,&sp8sMutex_r,&sp1sMutex_w,&sp1sLock,
-    &sp8sTid_r,&sp1sTid_w,sp8sBuf_r,sp1sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp8sBR,NULL},
-
-  /*
-  * This data defines sp2s cross-connected to sp3s.
-  */
-  { "SyncExtLoopback","sp2s","sp3s",&mon2sMutex,&sp2sMutex_r,&sp3sMutex_w,&sp2sLock,
-    &sp2sTid_r,&sp3sTid_w,sp2sBuf_r,sp3sBuf_w,0,0,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp2sBR,NULL},
-  { "SyncExtLoopback","sp3s","sp2s",&mon3sMutex,&sp3sMutex_r,&sp2sMutex_w,&sp2sLock,
-    &sp3sTid_r,&sp2sTid_w,sp3sBuf_r,sp2sBuf_w,0,0,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp3sBR,NULL},
-
-  /*
-  * This data defines sp2s cross-connected to sp5s.
-  */
-  { "SyncExtLoopback","sp2s","sp5s",&mon2sMutex,&sp2sMutex_r,&sp5sMutex_w,&sp2sLock,
-    &sp2sTid_r,&sp5sTid_w,sp2sBuf_r,sp5sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp2sBR,NULL},
-  { "SyncExtLoopback","sp5s","sp2s",&mon5sMutex,&sp5sMutex_r,&sp2sMutex_w,&sp2sLock,
-    &sp5sTid_r,&sp2sTid_w,sp5sBuf_r,sp2sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp5sBR,NULL},
-
-  /*
-  * This data defines sp2s cross-connected to sp8s.
-  */
-  { "SyncExtLoopback","sp2s","sp8s",&mon2sMutex,&sp2sMutex_r,&sp8sMutex_w,&sp2sLock,
-    &sp2sTid_r,&sp8sTid_w,sp2sBuf_r,sp8sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp2sBR,NULL},
-  { "SyncExtLoopback","sp8s","sp2s",&mon8sMutex,&sp8sMutex_r,&sp2sMutex_w,&sp2sLock,
-    &sp8sTid_r,&sp2sTid_w,sp8sBuf_r,sp2sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp8sBR,NULL},
-
-  /*
-  * This data defines sp3s cross-connected to sp5s.
-  */
-  { "SyncExtLoopback","sp3s","sp5s",&mon3sMutex,&sp3sMutex_r,&sp5sMutex_w,&sp3sLock,
-    &sp3sTid_r,&sp5sTid_w,sp3sBuf_r,sp5sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp3sBR,NULL},
-  { "SyncExtLoopback","sp5s","sp3s",&mon5sMutex,&sp5sMutex_r,&sp3sMutex_w,&sp3sLock,
-    &sp5sTid_r,&sp3sTid_w,sp5sBuf_r,sp3sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp5sBR,NULL},
-
-  /*
-  * This data defines sp3s cross-connected to sp8s.
-  */
-  { "SyncExtLoopback","sp3s","sp8s",&mon3sMutex,&sp3sMutex_r,&sp8sMutex_w,&sp3sLock,
-    &sp3sTid_r,&sp8sTid_w,sp3sBuf_r,sp8sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp3sBR,NULL},
-  { "SyncExtLoopback","sp8s","sp3s",&mon8sMutex,&sp8sMutex_r,&sp3sMutex_w,&sp3sLock,
-    &sp8sTid_r,&sp3sTid_w,sp8sBuf_r,sp3sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp8sBR,NULL},
+static int32 spPortId (const char *name)
+{
+  int32 id;
 
-  /*
-  * This data defines sp5s cross-connected to sp8s.
-  */
-  { "SyncExtLoopback","sp5s","sp8s",&mon5sMutex,&sp5sMutex_r,&sp8sMutex_w,&sp5sLock,
-    &sp5sTid_r,&sp8sTid_w,sp5sBuf_r,sp8sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp5sBR,NULL},
-  { "SyncExtLoopback","sp8s","sp5s",&mon8sMutex,&sp8sMutex_r,&sp5sMutex_w,&sp5sLock,
-    &sp8sTid_r,&sp5sTid_w,sp8sBuf_r,sp5sBuf_w,0,32,32,1,protSync,-1,-1,unscheduled,
-    unscheduled,sp8sBR,NULL},
+  for (id = 0; spPorts[id].name != NULL; id++) {
+    if (strcmp (spPorts[id].name,name) == 0) {
+      return (id);
+    }
+  }
 
-  /*
-  * This ends the list.
-  */
-  { NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,
-    0,0,0,0,protNone,-1,-1,unscheduled,unscheduled,NULL,NULL}
-};
+  return (-1);
+}
 
 typedef enum {
   waitAndScroll,
@@ -1640,7 +1284,7 @@ static int32   txFlags = O_RDWR  /*|O_NONBLOCK|O_ASYNC|O_NOCTTY|O_NDELAY*/;
 static u_int32 baudRateOveride = 0;   // don't overide
 static u_int8  rxType = 2;            // choose receiver software design
 
-static int32   tmoMultiplier = 1000;  // timeout multiplier
+static int32   tmoMultiplier = 0;     // fixed timeout multiplier, 0 adapts to the line
 #ifdef PARALLEL_PORTS
 static bool    showParallelPorts = false; // don't show
 #endif
@@ -1702,156 +1346,296 @@ static u_int32 mapBaudRate (speed_t br)
   return ret;
 }
 
-static int32 mapsdlcbaud(u_int32 rate)
+/*
+*
+* Receive timeouts
+*
+* A frame may take its wire time plus the latency beyond wire time seen
+* on the port pair at this baud rate. That latency is tracked as a
+* weighted average and mean deviation, like a TCP round trip time, and
+* the timeout allows the average plus SP_TMO_K deviations. A cable that
+* stops answering is flagged within milliseconds of the usual latency.
+* Until SP_TMO_WARM frames have passed, SP_TMO_COLD_US is allowed. With
+* -y the timeout is a fixed multiple of the wire time as before.
+*
+*/
+
+#define SP_TMO_ALPHA   0.125     // weight of the latest frame in the average
+#define SP_TMO_BETA    0.25      // weight of the latest frame in the deviation
+#define SP_TMO_K       4.0       // deviations allowed beyond the average
+#define SP_TMO_WARM    8u        // frames before the average is used
+#define SP_TMO_COLD_US 500000.0  // latency allowed until then
+#define SP_TMO_MIN_US  20000.0   // latency always allowed, scheduling jitter
+
+static float64 spWireUsecs (const spDatDat_t *spdp)
 {
-    int32 cnt;
+  return (((float64)spdp->comSz * (float64)ASYNC_BITS_PER_BYTE * (float64)MICROSECONDS_IN_SEC) /
+          (float64)mapBaudRate(spdp->lbrp->baudRate));
+}
 
-    for(cnt = 0; cnt < 11; cnt++)
-    {
-      if (rate == ATC_B[cnt])
-      {
-        break;
-      }
-    }
+static void calculateTimeout (const spDatDat_t *spdp, struct timeval *tv)
+{
+  const bRate_t *brp = spdp->lbrp;
+  float64 wire, timeoutUsecs;
 
-    if (cnt == 11)
-    {
-      fitPrint(ERROR, "%s Baudrate not supported", __func__);
-      cnt = -1;
-    }
+  wire = spWireUsecs (spdp);
+
+  if (tmoMultiplier != 0) {
+    timeoutUsecs = wire * (float64)tmoMultiplier;
+  } else if (brp->tmoN < SP_TMO_WARM) {
+    timeoutUsecs = wire + SP_TMO_COLD_US;
+  } else {
+    timeoutUsecs = wire + MAX(brp->tmoMean + (SP_TMO_K * brp->tmoDev),SP_TMO_MIN_US);
+  }
 
-    return cnt;
+  //fitPrint(VERBOSE, "timeout for BAUD %lu, numBytes %u waits %.0f microseconds\n", mapBaudRate(brp->baudRate), spdp->comSz, timeoutUsecs);
+
+  tv->tv_sec  = (time_t)(timeoutUsecs / (float64)MICROSECONDS_IN_SEC);
+  tv->tv_usec = (suseconds_t)(timeoutUsecs - ((float64)tv->tv_sec * (float64)MICROSECONDS_IN_SEC));
 }
 
 /*
-* Set the new baud rate*
-* NOTE: if retVal is 0 or positive, it represents the old
-* rate. Otherwise, it is an error code.
+* Fold the latency of a good frame into the timeout of its baud rate
 */
-static int32 set_spx_bit_rate (int32 fd, u_int32 rate)
+static void spTmoUpdate (const spDatDat_t *spdp,const bRateMsmnt_t *lbrmp)
 {
-  int32    retVal = 0;
-  int32    tmprate;
-  user_spx_ioctl_t user_spx_ioctl_data;
-  atc_spxs_config_t spxs;
+  bRate_t *brp = spdp->lbrp;
+  float64  usec, err;
 
-  switch(targetARCH) {
-    case ARCH_82XX:
-      memset(&user_spx_ioctl_data,0,sizeof(user_spx_ioctl_t));
+  usec = ((float64)(lbrmp->end.tv_sec - lbrmp->start.tv_sec) * 1.0e6) +
+         ((float64)(lbrmp->end.tv_nsec - lbrmp->start.tv_nsec) / 1.0e3);
+  usec -= spWireUsecs (spdp); // a pty may beat the wire time, so this can go negative
 
-      retVal = ioctl (fd, ATC_SPXS_READ_CONFIG, &user_spx_ioctl_data);
-      if (retVal >= 0)
-      {
-        user_spx_ioctl_data.x[1] = rate; // new baud rate
-        retVal = ioctl (fd, ATC_SPXS_WRITE_CONFIG, &user_spx_ioctl_data);
-      }
-      break;
-    case ARCH_UNKNOWN:  // ATC 6
-    case ARCH_83XX:
-      spxs.protocol = 0;
-      tmprate = mapsdlcbaud(rate);
-      if (tmprate == -1)
-      {
-        retVal = -1;
-      }
-      else
-      {
-        spxs.baud = (u_int8)tmprate;
-        spxs.transmit_clock_source = 0;
-        spxs.transmit_clock_mode = 1;
-        retVal = ioctl (fd, ATC_SPXS_WRITE_CONFIG, &spxs);
-      }
-      break;
-    default:
-      retVal = -1;
-      break;
+  if (brp->tmoN == 0u) {
+    brp->tmoMean = usec;
+    brp->tmoDev  = usec / 2.0;
+  } else {
+    err = usec - brp->tmoMean;
+    brp->tmoMean += SP_TMO_ALPHA * err;
+    brp->tmoDev  += SP_TMO_BETA * (((err < 0.0) ? -err : err) - brp->tmoDev);
   }
 
-  if (retVal < 0) {
-    fitPrint(ERROR, "set_spx_bit_rate: ioctl command %d failed, ret %ld, err %d, %s\n",
-             ATC_SPXS_WRITE_CONFIG,retVal,errno,strerror(errno));
-    return (retVal);
-  }
-  return (retVal);
+  brp->tmoN++;
 }
 
-#ifdef DUMP_TERMIOS
-static void dumpTermios(const struct termios *tp)
+/*
+* Discard the rest of a failed frame until the line has been quiet for a
+* frame timeout, so late bytes do not shift every frame after it
+*/
+#define SP_DRAIN_MAX (4u * MAX_TRANSFER) // give up on a line that never stops
+
+static void spDrain (const spDatDat_t *spdp)
 {
-  int32 i;
-  fprintf(stderr,"Size of flags is %u\n", sizeof(tp->c_cflag));
-  fprintf(stderr,"%s:\tiflags:%o oflags:%o cflags:%o \n",
-          __func__,tp->c_iflag,tp->c_oflag,tp->c_cflag);
-  fprintf(stderr,"\t\tlflags:0x%x line-disc:%u ispeed:%u ospeed:%u\n",
-         tp->c_lflag,tp->c_line,tp->c_ispeed,tp->c_ospeed);
-  fprintf(stderr,"%s: control chars:",__func__);
-  for(i=0;i<NCCS;i++)
-    fprintf(stderr," %02x",tp->c_cc[i]);
-  fprintf(stderr,"\n");
+  char     buf[64];
+  fd_set   rfds;
+  struct timeval tv;
+  ssize_t  bCnt = 1;
+  u_int32  total = 0u;
+
+  while ((bCnt > 0) && (total < SP_DRAIN_MAX)) {
+    FD_ZERO(&rfds);
+    FD_SET(spdp->fd_r, &rfds);
+    calculateTimeout (spdp, &tv);
+
+    if (select (spdp->fd_r + 1, &rfds, NULL, NULL, &tv) <= 0) {
+      break;
+    }
+
+    bCnt = read (spdp->fd_r, buf, sizeof(buf));
+    if (bCnt > 0) {
+      total += (u_int32)bCnt;
+    }
+  }
+
+  if (total != 0u) {
+    fitPrint(VERBOSE, "%s discarded %lu late bytes from %s\n",
+             spdp->testName,total,spdp->devName_r);
+  }
 }
-#endif
 
-void initSerialPort (int32 fd,speed_t baudRate,spProt_t protocol,bool flowCntrl)
-{
-  struct termios t;
+/*
+*
+* Payload generator
+*
+* The receiver thread builds the transmit buffer with spGenFrame() and
+* keeps a copy of the generator state. As bytes arrive, spCheckBytes()
+* runs that copy forward and compares, so a frame is verified at O(1)
+* per byte without a reference buffer. Shift register, counter and random
+* states carry on from frame to frame, so a sweep is one long sequence.
+*
+*/
+
+static const char *spPatNames[] = {
+  "size","atc","count","prbs7","prbs15","prbs23","random",NULL
+};
+
+static spPat_t spPattern = patSize; // payload pattern
+static u_int32 spSeed = 1u;         // seed of the random pattern
 
-  tcgetattr (fd,&t);
+/*
+* Next eight bits of a Fibonacci shift register of degree n with a tap at t
+*/
+static u_int8 spPrbsByte (u_int32 *sp,u_int32 n,u_int32 t)
+{
+  u_int32 s = *sp, bit;
+  u_int8  b = 0;
+  plint   i;
+
+  for (i = 0; i < 8; i++) {
+    bit = ((s >> (n - 1u)) ^ (s >> (t - 1u))) & 1u;
+    s = ((s << 1) | bit) & ((1uL << n) - 1u);
+    b = (u_int8)((b << 1) | bit);
+  }
 
-  cfmakeraw (&t);
+  *sp = s;
+  return (b);
+}
 
-  t.c_cc[VMIN]  = 1;
-  t.c_cc[VTIME] = 2;
+static void spGenInit (spGen_t *gp)
+{
+  gp->pos = 0;
 
-  if (flowCntrl) {
-     t.c_cflag |= CRTSCTS;
+  switch (spPattern) {
+    case patRandom:
+      gp->state = (spSeed != 0u) ? spSeed : 1u; // xorshift cannot leave zero
+      break;
+    case patCount:
+      gp->state = 0;
+      break;
+    default:
+      gp->state = 0x7FFFFFu; // all ones seeds every shift register
+      break;
   }
+}
 
-  switch (protocol) {
-    case protAsync:
-      /*
-      * TODO: change interface to verify independent input/output rates.
-      */
-      (void) cfsetispeed (&t,baudRate);
-      (void) cfsetospeed (&t,baudRate);
+static u_int8 spGenByte (spGen_t *gp,size_t sz)
+{
+  const size_t atcLen = sizeof(atcTestString) - 1u;
+  u_int32 x;
+  u_int8  b;
+
+  switch (spPattern) {
+    case patAtc:
+      b = (u_int8)atcTestString[gp->pos % atcLen];
+      break;
+    case patCount:
+      b = (u_int8)gp->state++;
+      break;
+    case patPrbs7:
+      b = spPrbsByte (&gp->state,7u,6u);
+      break;
+    case patPrbs15:
+      b = spPrbsByte (&gp->state,15u,14u);
       break;
-    case protSync:
-      (void) set_spx_bit_rate (fd,baudRate);
+    case patPrbs23:
+      b = spPrbsByte (&gp->state,23u,18u);
       break;
-    case protNone:
+    case patRandom:
+      x = gp->state;
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      gp->state = x & 0xFFFFFFFFu;
+      b = (u_int8)gp->state;
+      break;
+    case patSize:
     default:
-      // nothing to do
+      if (useAtcTestString && (gp->pos < atcLen)) {
+        b = (u_int8)atcTestString[gp->pos]; // ATC test string on the first bytes
+      } else {
+        b = (u_int8)sz;
+      }
       break;
   }
 
-  (void) tcflush (fd,TCIOFLUSH); // Flush the input and output
+  gp->pos++;
+  return (b);
+}
 
-  #ifdef DUMP_TERMIOS
-  dumpTermios(&t);
-  #endif
+/*
+* Fill the transmit buffer and start the check of the frame
+*/
+static void spGenFrame (spDatDat_t *spdp)
+{
+  size_t i;
 
-  tcsetattr (fd,TCSANOW,&t);
+  spdp->gen.pos = 0;
+  spdp->chk.gen = spdp->gen;
+  spdp->chk.bad = false;
+  spdp->chk.badBit = 0;
+
+  for (i = 0; i < spdp->comSz; i++) {
+    spdp->buf_w[i] = (char)spGenByte (&spdp->gen,spdp->comSz);
+  }
 }
 
-static void calculateTimeout (const spDatDat_t *spdp, struct timeval *tv)
+/*
+* Check bytes of the current frame as they arrive
+*/
+static void spCheckBytes (spDatDat_t *spdp,const char *cp,size_t n)
+{
+  spCheck_t *ckp = &spdp->chk;
+  size_t i;
+  u_int8 x;
+
+  for (i = 0; i < n; i++) {
+    x = (u_int8)cp[i] ^ spGenByte (&ckp->gen,spdp->comSz);
+
+    if ((x != 0u) && !ckp->bad) {
+      ckp->bad = true;
+      ckp->badBit = ((ckp->gen.pos - 1u) * 8u) + (size_t)__builtin_ctz (x); // lsb goes first
+    }
+  }
+}
+
+/*
+* Account for a complete frame
+*/
+static ftRet_t spCheckFrame (spDatDat_t *spdp)
 {
-  int32 numBytes, bitsPerSec;
-  int32 timeoutUsecs;
+  ftRet_t ret;
 
-  bitsPerSec = (int32)mapBaudRate(spdp->lbrp->baudRate);
-  numBytes = (int32)spdp->comSz;
+  if (!spdp->chk.bad) {
+    /*
+    * Frame has been successfully transmitted and received
+    */
+    spdp->lbrp->rxOK++;
+    ret = ftUpdateTestStatus(ftrp,ftPass,NULL);
+  } else {
+    spdp->lbrp->rxNG++;
+    ret = ftUpdateTestStatus(ftrp,ftRxFail,NULL);
+    fitPrint(VERBOSE, "\n%s test failed for %s rx, %s tx size %u, baud %lu, %s pattern, " \
+             "first bad bit %u\n",spdp->testName,spdp->devName_r,spdp->devName_w,spdp->comSz,
+             mapBaudRate(spdp->lbrp->baudRate),spPatNames[spPattern],spdp->chk.badBit);
+    fitPrint(VERBOSE, "expected buffer (%p):",spdp->buf_w);
+    mdmp(spdp->buf_w,spdp->comSz,VERBOSE);
+    fitPrint(VERBOSE, "\nactual buffer   (%p):",spdp->buf_r);
+    mdmp(spdp->buf_r,spdp->comSz,VERBOSE);
+    fitPrint(VERBOSE, "\n\n");
+  }
 
-  timeoutUsecs = ((numBytes * ASYNC_BITS_PER_BYTE * MICROSECONDS_IN_SEC) / bitsPerSec) ;
-  /* Arbitrary x times longer than it should take
-   * 5 mostly worked but we received some erroneous timeouts with certain packet sizes
-   * 50 times longer should be more than enough
-   */
-  timeoutUsecs *= tmoMultiplier;
+  return (ret);
+}
 
-  //fitPrint(VERBOSE, "timeout for BAUD %d, numBytes %d waits %lu microseconds\n", bitsPerSec, numBytes, timeoutUsecs);
+/*
+* Select the payload pattern, a random pattern takes an optional seed: random:42
+*/
+static int32 spPatternOf (const char *arg)
+{
+  size_t  len = strcspn (arg,":");
+  plint   i;
+
+  for (i = 0; spPatNames[i] != NULL; i++) {
+    if ((strlen (spPatNames[i]) == len) && (strncmp (spPatNames[i],arg,len) == 0)) {
+      spPattern = (spPat_t)i;
+      if (arg[len] == ':') {
+        spSeed = strtoul (&arg[len + 1u],NULL,0);
+      }
+      return (0);
+    }
+  }
 
-  /* Wait up to one second. */
-  tv->tv_sec = (int32)timeoutUsecs / MICROSECONDS_IN_SEC;
-  tv->tv_usec = timeoutUsecs % MICROSECONDS_IN_SEC;
+  return (-1);
 }
 
 /*
@@ -1861,12 +1645,10 @@ static void calculateTimeout (const spDatDat_t *spdp, struct timeval *tv)
 * expect to receive the requested size
 *
 */
-static ftRet_t rxTypeZero (const spDatDat_t *spdp,bRateMsmnt_t *lbrmp)
+static ftRet_t rxTypeZero (spDatDat_t *spdp,bRateMsmnt_t *lbrmp)
 {
   int32     reTry=0;
-  u_int32   i;
   ssize_t   bCnt;
-  const char   *cp;
   ftRet_t ret = ftFail;
   fd_set  rfds;
   int32     retval;
@@ -1916,36 +1698,8 @@ eagain0:
 
       clock_gettime(CLOCK_MONOTONIC ,&lbrmp->end); // end timing this frame
 
-      if (memcmp (spdp->buf_r,spdp->buf_w,spdp->comSz) == 0) {
-        /*
-        * Frame has been successfully transmitted and received
-        */
-        spdp->lbrp->rxOK++;
-        ret = ftUpdateTestStatus(ftrp,ftPass,NULL);
-      } else {
-        spdp->lbrp->rxNG++;
-        ret = ftUpdateTestStatus(ftrp,ftRxFail,NULL);
-        fitPrint(VERBOSE, "\n%s test failed for %s rx, %s tx size %u, baud %lu\n",
-                 spdp->testName,spdp->devName_r,spdp->devName_w,spdp->comSz,
-                 mapBaudRate(spdp->lbrp->baudRate));
-        fitPrint(VERBOSE, "expected buffer (%p):",spdp->buf_w);
-        cp = spdp->buf_w;
-        for (i=0;i < spdp->comSz;i++) {
-          if ((i%32u) == 0u) { // format output
-            fitPrint(VERBOSE, "\n");
-          }
-          fitPrint(VERBOSE, "%2.2x",*cp++);
-        }
-        fitPrint(VERBOSE, "\nactual buffer   (%p):",spdp->buf_r);
-        cp = spdp->buf_r;
-        for (i=0;i<spdp->comSz;i++) {
-          if ((i%32u) == 0u) { // format output
-            fitPrint(VERBOSE, "\n");
-          }
-          fitPrint(VERBOSE, "%2.2x",*cp++);
-        }
-        fitPrint(VERBOSE, "\n\n");
-      }
+      spCheckBytes (spdp,spdp->buf_r,spdp->comSz);
+      ret = spCheckFrame (spdp);
     }
   }
 
@@ -1960,10 +1714,10 @@ eagain0:
 *
 */
 
-static ftRet_t rxTypeOne (const spDatDat_t *spdp,bRateMsmnt_t *lbrmp)
+static ftRet_t rxTypeOne (spDatDat_t *spdp,bRateMsmnt_t *lbrmp)
 {
   int32 reTry=0, bCnt;
-  u_int i,j;
+  u_int i;
   char *cp;
   ftRet_t ret = ftFail;
   fd_set rfds;
@@ -2023,216 +1777,990 @@ eagain1:
       }
       else
       {
-        /*
-        * Received a frame, check payload
-        */
-        clock_gettime(CLOCK_MONOTONIC,&lbrmp->end); // end timing this frame
-        if (memcmp (spdp->buf_r,spdp->buf_w,spdp->comSz) == 0)\
+        spCheckBytes (spdp,cp,1u); // check each byte as it arrives
+
+        if (i == (spdp->comSz - 1u))
         {
           /*
-          * Frame has been successfully transmitted and received
+          * Received a frame, check payload
           */
-          spdp->lbrp->rxOK++;
-          ret = ftUpdateTestStatus(ftrp,ftPass,NULL);
-        }
-        else
-        {
-          spdp->lbrp->rxNG++;
-          ret = ftUpdateTestStatus(ftrp,ftRxFail,NULL);
-          fitPrint(VERBOSE, "\n%s test failed for %s rx, %s tx size %u, baud %lu\n",
-                   spdp->testName,spdp->devName_r,spdp->devName_w,spdp->comSz,
-                   mapBaudRate(spdp->lbrp->baudRate));
-          fitPrint(VERBOSE, "expected buffer (%p):",spdp->buf_w);
-          cp = spdp->buf_w;
-          for (j=0u;j < spdp->comSz;j++)
-          {
-            if ((j%32u) == 0u)
-            { // format output
-              fitPrint(VERBOSE, "\n");
-            }
-            fitPrint(VERBOSE, "%2.2x",*cp++);
-          }
-          fitPrint(VERBOSE, "\nactual buffer   (%p):",spdp->buf_r);
-          cp = spdp->buf_r;
-          for (j=0;j<spdp->comSz;j++)
-          {
-            if ((j%32u) == 0u)
-            { // format output
-              fitPrint(VERBOSE, "\n");
-            }
-            fitPrint(VERBOSE, "%2.2x",*cp++);
-          }
-          fitPrint(VERBOSE, "\n\n");
+          clock_gettime(CLOCK_MONOTONIC,&lbrmp->end); // end timing this frame
+          ret = spCheckFrame (spdp);
         }
       }
     } // else retval != 0
 
-    cp++;
-  } // for(cp...)
+    if ((bCnt != 1) || (retval <= 0))
+    {
+      break; // the frame is lost
+    }
+
+    cp++;
+  } // for(cp...)
+
+  return (ret);
+}
+
+/*
+*
+* Receiver Type 2
+*
+* packet may be assembled from fragmented frames
+*
+*/
+static ftRet_t rxTypeTwo (spDatDat_t *spdp,bRateMsmnt_t *lbrmp)
+{
+  int32 reTry=0, bCnt, i;
+  char *cp = spdp->buf_r;
+  ftRet_t ret = ftFail;
+  fd_set rfds;
+  struct timeval tv;
+  int32 retval;
+
+  FD_ZERO(&rfds);
+  FD_SET(spdp->fd_r, &rfds);
+  i=(int32)spdp->comSz;
+
+eagain2:
+  bCnt = -1;
+  calculateTimeout (spdp, &tv);
+  retval = select (spdp->fd_r + 1, &rfds, NULL, NULL, &tv);
+
+  if (retval == 0)
+  {
+    // Select timed out
+    fitPrint(VERBOSE, "%s timed out reading from %s, fd %ld, sz %4.4u, baud %lu\n",
+             spdp->testName,spdp->devName_r,spdp->fd_r,spdp->comSz,
+             mapBaudRate(spdp->lbrp->baudRate));
+    spdp->lbrp->rxNG++;
+    ret = ftUpdateTestStatus(ftrp,ftRxTimeout,NULL);
+  }
+  else if ((retval == -1) || ((bCnt = read (spdp->fd_r,cp,(size_t)i)) == -1))
+  {
+    if (EAGAIN == errno) {
+      if (++reTry > RETRY_CNT) {
+        fitPrint(VERBOSE, "%s nothing to read, err %d\n",spdp->testName,errno);
+      } else {
+        goto eagain2;
+      }
+    }
+    fitPrint(VERBOSE, "%s cannot read from %s, err %d, %s, fd %ld, sz %4.4u, baud %lu\n",
+             spdp->testName,spdp->devName_r,errno,strerror(errno),spdp->fd_r,spdp->comSz,
+             mapBaudRate(spdp->lbrp->baudRate));
+    spdp->lbrp->rxNG++;
+    ret = ftUpdateTestStatus(ftrp,ftRxError,NULL);
+  }
+  else
+  {
+    if (bCnt > 0)
+    {
+      spCheckBytes (spdp,cp,(size_t)bCnt); // check the bytes as they arrive
+    }
+
+    if (bCnt != i)
+    {
+      if (rxType != 2u)
+      {
+        fitPrint(VERBOSE, "%s %s returned read byte count %ld, expected %ld, baud %lu\n",
+                 spdp->testName,spdp->devName_r,bCnt,i,mapBaudRate(spdp->lbrp->baudRate));
+      }
+
+      /*
+      * Check for partial successful read. Update request and pointers.
+      */
+      if ((bCnt < i) && (bCnt != 0))
+      {
+        i -= bCnt;
+        cp = &cp[bCnt];
+        reTry = 0;
+        goto eagain2; // try to read the rest of the buffer
+      }
+      else
+      {
+        spdp->lbrp->rxNG++;
+        ret = ftUpdateTestStatus(ftrp,ftRxFail,NULL);
+      }
+    } //if (bCnt != i)
+    else  //bCnt == i
+    {
+      /*
+      * Received a frame, check payload
+      */
+
+      clock_gettime(CLOCK_MONOTONIC, &lbrmp->end);   // end timing this frame
+
+      ret = spCheckFrame (spdp);
+    }  //bCnt == i
+  }
+
+  return (ret);
+}
+
+/*
+*
+* Receive reactor
+*
+* With receiver type 4 (-x 4) a single thread owns an epoll set holding
+* every scheduled fd_r. A receiver arms its frame with spRxArm() and
+* writes it, the reactor reads whatever arrives into the frame buffer and
+* posts the receiver when the last byte is in, so frame completion is
+* stamped as the data lands instead of after a select() per read.
+* Descriptors are registered one shot and are rearmed only while a frame
+* is outstanding.
+*
+* As the receiver no longer blocks in read() it needs no transmitter
+* thread, see spTxInline(). N stop and wait tests run on N threads and
+* the reactor instead of 2N threads.
+*
+*/
+#define SP_REACTOR_EVENTS 16
+#define SP_REACTOR_TMO_MS 100 // how often the reactor checks for shutdown
+
+static int32         spEpfd = -1;          // reactor epoll instance
+static pthread_t     spReactorTid;         // reactor thread ID
+static volatile bool spReactorRun = false;
+
+/*
+* Read whatever is available into the armed frame, called by the reactor
+*/
+static void spReactorRead (spDatDat_t *spdp)
+{
+  spRxFrame_t *rf = &spdp->rxf;
+  struct epoll_event ev;
+  ssize_t bCnt;
+  bool    rearm = false;
+
+  pthread_mutex_lock (&rf->lock);
+
+  if (rf->armed) {
+    bCnt = read (spdp->fd_r,rf->cp,rf->want);
+
+    if (bCnt > 0) {
+      spCheckBytes (spdp,rf->cp,(size_t)bCnt); // the receiver waits until done
+      rf->cp = &rf->cp[bCnt];
+      rf->want -= (size_t)bCnt;
+
+      if (rf->want == 0u) {
+        clock_gettime (CLOCK_MONOTONIC,&rf->end); // end timing this frame
+        rf->armed = false;
+        sem_post (&rf->done);
+      } else {
+        rearm = true; // partial frame
+      }
+    } else if ((bCnt == -1) && ((errno == EAGAIN) || (errno == EINTR))) {
+      rearm = true;
+    } else {
+      rf->err = (bCnt == 0) ? EIO : errno;
+      rf->armed = false;
+      sem_post (&rf->done);
+    }
+
+    if (rearm) {
+      ev.events = EPOLLIN | EPOLLONESHOT;
+      ev.data.ptr = spdp;
+      (void) epoll_ctl (spEpfd,EPOLL_CTL_MOD,spdp->fd_r,&ev);
+    }
+  }
+
+  pthread_mutex_unlock (&rf->lock);
+}
+
+static void *spReactor (void *vp)
+{
+  struct epoll_event ev[SP_REACTOR_EVENTS];
+  int32 n, i;
+
+  (void) vp;
+
+  while (spReactorRun) {
+    n = epoll_wait (spEpfd,ev,SP_REACTOR_EVENTS,SP_REACTOR_TMO_MS);
+
+    for (i = 0; i < n; i++) {
+      spReactorRead (ev[i].data.ptr);
+    }
+  }
+
+  return (NULL);
+}
+
+static int32 spReactorStart (void)
+{
+  int32 retVal;
+
+  spEpfd = epoll_create (SP_REACTOR_EVENTS);
+  if (spEpfd == -1) {
+    fitPrint(ERROR, "cannot create receive reactor, err %d, %s\n",errno,strerror(errno));
+    return (-1);
+  }
+
+  spReactorRun = true;
+  retVal = pthread_create (&spReactorTid,NULL,spReactor,NULL);
+  if (retVal != 0) {
+    fitPrint(ERROR, "can't pthread_create receive reactor, errno 0x%lx\n",retVal);
+    spReactorRun = false;
+    close (spEpfd);
+    spEpfd = -1;
+    return (-1);
+  }
+
+  return (0);
+}
+
+static void spReactorStop (void)
+{
+  if (spEpfd == -1) {
+    return;
+  }
+
+  spReactorRun = false;
+  (void) pthread_join (spReactorTid,NULL);
+  close (spEpfd);
+  spEpfd = -1;
+}
+
+/*
+* Hand the receive descriptor of a test to the reactor, disarmed
+*/
+static int32 spReactorAdd (spDatDat_t *spdp)
+{
+  struct epoll_event ev;
+  int32 retVal;
+
+  ev.events = EPOLLONESHOT;
+  ev.data.ptr = spdp;
+
+  retVal = epoll_ctl (spEpfd,EPOLL_CTL_ADD,spdp->fd_r,&ev);
+  if ((retVal == -1) && (errno == EEXIST)) {
+    retVal = epoll_ctl (spEpfd,EPOLL_CTL_MOD,spdp->fd_r,&ev);
+  }
+
+  if (retVal == -1) {
+    fitPrint(ERROR, "%s cannot add %s to the receive reactor, err %d, %s\n",
+             spdp->testName,spdp->devName_r,errno,strerror(errno));
+  }
+
+  return (retVal);
+}
+
+/*
+* Expect the next frame, must be called before the frame is written
+*/
+static void spRxArm (spDatDat_t *spdp)
+{
+  spRxFrame_t *rf = &spdp->rxf;
+  struct epoll_event ev;
+
+  pthread_mutex_lock (&rf->lock);
+
+  while (sem_trywait (&rf->done) == 0) {
+    // drop a completion that raced with a timeout
+  }
+
+  rf->cp = spdp->buf_r;
+  rf->want = spdp->comSz;
+  rf->err = 0;
+  rf->armed = true;
+
+  ev.events = EPOLLIN | EPOLLONESHOT;
+  ev.data.ptr = spdp;
+  (void) epoll_ctl (spEpfd,EPOLL_CTL_MOD,spdp->fd_r,&ev);
+
+  pthread_mutex_unlock (&rf->lock);
+}
+
+/*
+*
+* Receiver Type 4
+*
+* wait for the reactor to assemble the frame, then verify it
+*
+*/
+static ftRet_t rxTypeFour (spDatDat_t *spdp,bRateMsmnt_t *lbrmp)
+{
+  spRxFrame_t *rf = &spdp->rxf;
+  struct timeval  tv;
+  struct timespec ts;
+  ftRet_t ret = ftFail;
+  bool    timedOut = false;
+  int32   c;
+
+  calculateTimeout (spdp, &tv);
+  clock_gettime (CLOCK_REALTIME,&ts);
+  ts.tv_sec += tv.tv_sec;
+  ts.tv_nsec += tv.tv_usec * 1000;
+  if (ts.tv_nsec >= 1000000000) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+
+  do {
+    c = sem_timedwait (&rf->done,&ts);
+  } while ((c == -1) && (errno == EINTR));
+
+  if (c == -1) {
+    pthread_mutex_lock (&rf->lock);
+    timedOut = rf->armed;
+    rf->armed = false; // the reactor leaves the buffer alone from here on
+    pthread_mutex_unlock (&rf->lock);
+
+    if (!timedOut) {
+      sem_wait (&rf->done); // completed right at the deadline
+    }
+  }
+
+  if (timedOut) {
+    fitPrint(VERBOSE, "%s timed out reading from %s, fd %ld, sz %4.4u, baud %lu\n",
+             spdp->testName,spdp->devName_r,spdp->fd_r,spdp->comSz,
+             mapBaudRate(spdp->lbrp->baudRate));
+    spdp->lbrp->rxNG++;
+    ret = ftUpdateTestStatus(ftrp,ftRxTimeout,NULL);
+  } else if (rf->err != 0) {
+    fitPrint(VERBOSE, "%s cannot read from %s, err %d, %s, fd %ld, sz %4.4u, baud %lu\n",
+             spdp->testName,spdp->devName_r,rf->err,strerror(rf->err),spdp->fd_r,
+             spdp->comSz,mapBaudRate(spdp->lbrp->baudRate));
+    spdp->lbrp->rxNG++;
+    ret = ftUpdateTestStatus(ftrp,ftRxError,NULL);
+  } else {
+    lbrmp->end = rf->end; // stamped by the reactor
+    ret = spCheckFrame (spdp);
+  }
+
+  return (ret);
+}
+
+/*
+*
+* Pipelined frame stream
+*
+* With -w the writer streams the whole frame size sweep of a baud rate
+* without waiting for each echo. At most spWindow frames are in flight,
+* the receiver hands back a credit for every frame it accounts for. Each
+* frame carries a sequence number so drops can be told from reordering:
+*
+*   SP_WIN_SYNC, sequence (2 bytes), frame length (2 bytes), payload, xor
+*
+* Frames shorter than SP_WIN_MIN are padded to that length.
+*
+*/
+
+#define SP_WIN_SYNC 0xA5u
+#define SP_WIN_HDR  5u              // sync, sequence and frame length
+#define SP_WIN_MIN  (SP_WIN_HDR + 2u) // one payload byte and the xor
+
+static u_int32 spWindow = 0; // frames in flight, 0 is stop and wait
+
+/*
+* Build frame seq of len bytes, returns the padded length
+*/
+static size_t spWinFrame (u_int8 *bp,size_t len,u_int16 seq)
+{
+  size_t i;
+  u_int8 x = 0;
+
+  len = MAX(len,SP_WIN_MIN);
+  bp[0] = SP_WIN_SYNC;
+  bp[1] = (u_int8)(seq >> 8);
+  bp[2] = (u_int8)seq;
+  bp[3] = (u_int8)(len >> 8);
+  bp[4] = (u_int8)len;
+
+  for (i = SP_WIN_HDR; i < (len - 1u); i++) {
+    bp[i] = (u_int8)(seq + i); // payload differs from frame to frame
+  }
+
+  for (i = 0; i < (len - 1u); i++) {
+    x ^= bp[i];
+  }
+  bp[len - 1u] = x;
+
+  return (len);
+}
+
+/*
+* Wait until the transmitter thread can take the next frame
+*/
+static int32 spWaitForTx (spDatDat_t *spdp)
+{
+  struct timespec ts;
+  int32 c;
+
+  clock_gettime (CLOCK_REALTIME,&ts);
+  ts.tv_sec += MAX_WAIT_FOR_TX;
+
+  do {
+    c = sem_timedwait (&spdp->txRdy,&ts);
+  } while ((c == -1) && (errno == EINTR));
+
+  if (c != 0) {
+    fitPrint(ERROR, "receiver %s timeout transmitter %s, fd %ld, sz %4.4u, " \
+             "baud %lu\n",spdp->devName_r,spdp->devName_w,spdp->fd_w,spdp->comSz,
+             mapBaudRate(spdp->lbrp->baudRate));
+  }
+
+  return (c);
+}
+
+/*
+* With the reactor reading the frames the receiver thread writes them too,
+* a test then has no transmitter thread. Not with flow control: a write
+* held by a dead cable would block the receiver for good, the transmitter
+* thread blocks instead and the receiver reports ftTxTimeout.
+*/
+static bool spTxInline (void)
+{
+  return ((rxType == 4u) && (spWindow == 0u) && !enableFlowControl);
+}
+
+/*
+* Transmitter side of the stream, runs until the sweep is sent or the receiver stops
+*/
+static ftRet_t spWinTx (spDatDat_t *spdp)
+{
+  spWin_t *wp = &spdp->win;
+  bRate_t *brp = spdp->lbrp; // the receiver moves on once it has the last frame
+  u_int8  *bp = (u_int8 *)spdp->buf_w;
+  size_t   nSz = spdp->maxFrameSize - spdp->minFrameSize + 1u;
+  size_t   len, off;
+  ssize_t  bCnt = 0;
+  u_int32  n;
+  ftRet_t  ret = ftPass;
+
+  for (n = 0; (n < wp->total) && !wp->stop; n++) {
+    sem_wait (&wp->credit); // the window is full until the receiver returns a credit
+    if (wp->stop) {
+      break;
+    }
+
+    len = spWinFrame (bp,spdp->minFrameSize + (n % nSz),(u_int16)n);
+
+    for (off = 0; off < len; off += (size_t)bCnt) {
+      bCnt = write (spdp->fd_w,&bp[off],len - off);
+      if (bCnt == -1) {
+        if (errno == EINTR) {
+          bCnt = 0;
+          continue;
+        }
+        break;
+      }
+    }
+
+    if (bCnt == -1) {
+      fitPrint(ERROR, "%s cannot write from %s, err %d, %s, fd %ld, sz %4.4u\n",
+               spdp->testName,spdp->devName_w,errno,strerror(errno),spdp->fd_w,len);
+      brp->txNG++;
+      ret = ftUpdateTestStatus(ftrp,ftTxError,NULL);
+      break;
+    }
+
+    brp->txOK++;
+  }
+
+  return (ret);
+}
+
+/*
+* Receiver side of the stream, one call covers the sweep of the current baud rate
+*/
+static ftRet_t spWinRx (spDatDat_t *spdp)
+{
+  spWin_t *wp = &spdp->win;
+  u_int8  *bp = (u_int8 *)spdp->buf_r;
+  u_int8   exp[MAX_TRANSFER];
+  size_t   fill = 0, len;
+  ssize_t  bCnt;
+  u_int32  i, seen = 0;
+  u_int16  seq, gap, next = 0;
+  bool     inSync = true;
+  fd_set   rfds;
+  int32    c;
+  struct timeval  tv;
+  struct timespec start, end;
+  float64  secs, rate, lineRate;
+  ftRecord_t rec;
+  const float64 bitsPerByte = (spdp->protocol == protAsync) ? 10.0 : 8.0;
+  ftRet_t  ret = ftPass;
+
+  spdp->comSz = MAX(spdp->maxFrameSize,SP_WIN_MIN); // time out on the longest frame
+  if (spWaitForTx (spdp) != 0) {
+    return (ftUpdateTestStatus(ftrp,ftTxTimeout,NULL));
+  }
+
+  /*
+  * The writer is parked on mp_w, a stream of the previous baud rate that
+  * ended on a timeout or read error has been stopped and left nothing
+  * behind but credits
+  */
+  wp->stop  = false;
+  wp->total = spdp->iter * (u_int32)(spdp->maxFrameSize - spdp->minFrameSize + 1u);
+  wp->ok    = 0;
+  wp->drop  = 0;
+  wp->ooo   = 0;
+  wp->bad   = 0;
+  wp->bytes = 0.0;
+
+  while (sem_trywait (&wp->credit) == 0) {
+    // drop the credits left over from the previous baud rate
+  }
+  for (i = 0; i < spWindow; i++) {
+    sem_post (&wp->credit);
+  }
+
+  spdp->spSt_r = receiving;
+  clock_gettime (CLOCK_MONOTONIC,&start);
+  sem_post (spdp->mp_w); // start the stream
+
+  while (seen < wp->total) {
+    FD_ZERO(&rfds);
+    FD_SET(spdp->fd_r, &rfds);
+    calculateTimeout (spdp, &tv);
+    c = select (spdp->fd_r + 1, &rfds, NULL, NULL, &tv);
+
+    if ((c == -1) && (errno == EINTR)) {
+      continue;
+    }
+
+    if (c == 0) {
+      fitPrint(VERBOSE, "%s timed out reading from %s after %lu of %lu frames, baud %lu\n",
+               spdp->testName,spdp->devName_r,seen,wp->total,
+               mapBaudRate(spdp->lbrp->baudRate));
+      ret = ftRxTimeout;
+      break;
+    }
+
+    bCnt = (c == -1) ? -1 : read (spdp->fd_r,&bp[fill],MAX_TRANSFER - fill);
+    if (bCnt <= 0) {
+      if ((bCnt == -1) && ((errno == EINTR) || (errno == EAGAIN))) {
+        continue;
+      }
+      fitPrint(VERBOSE, "%s cannot read from %s, err %d, %s, fd %ld, baud %lu\n",
+               spdp->testName,spdp->devName_r,errno,strerror(errno),spdp->fd_r,
+               mapBaudRate(spdp->lbrp->baudRate));
+      ret = ftRxError;
+      break;
+    }
+    fill += (size_t)bCnt;
+
+    /*
+    * Take the complete frames off the front of the buffer
+    */
+    while ((fill >= SP_WIN_HDR) && (seen < wp->total)) {
+      len = ((size_t)bp[3] << 8) | bp[4];
+
+      if ((bp[0] != SP_WIN_SYNC) || (len < SP_WIN_MIN) || (len > MAX_TRANSFER)) {
+        len = 0u; // not the start of a frame
+      } else if (fill < len) {
+        break; // wait for the rest of the frame
+      } else {
+        seq = (u_int16)(((u_int16)bp[1] << 8) | bp[2]);
+        (void) spWinFrame (exp,len,seq);
+        gap = (u_int16)(seq - next);
+
+        if (memcmp (bp,exp,len) != 0) {
+          len = 0u;
+        } else if (gap > (wp->total - seen - 1u)) {
+          wp->ooo++; // its credit was returned with the gap
+          inSync = true;
+        } else {
+          clock_gettime (CLOCK_MONOTONIC,&end);
+          wp->ok++;
+          wp->drop += gap;
+          wp->bytes += (float64)len;
+          seen += (u_int32)gap + 1u;
+          next = seq + 1u;
+          inSync = true;
+
+          for (i = 0; i <= gap; i++) {
+            sem_post (&wp->credit); // dropped frames free their slot too
+          }
+          (void) ftUpdateTestStatus(ftrp,ftPass,NULL);
+        }
+      }
+
+      if (len == 0u) {
+        if (inSync) {
+          wp->bad++; // count each loss of synchronization once
+          inSync = false;
+        }
+        len = 1u; // resynchronize on the next byte
+      }
+
+      fill -= len;
+      memmove (bp,&bp[len],fill);
+    }
+  }
+
+  wp->drop += wp->total - seen; // whatever did not arrive before the timeout
+  wp->stop = true;
+  for (i = 0; i < spWindow; i++) {
+    sem_post (&wp->credit); // release a writer blocked on the window
+  }
+
+  if (wp->ok == 0u) {
+    end = start;
+  }
+  secs = (float64)(end.tv_sec - start.tv_sec) + ((float64)(end.tv_nsec - start.tv_nsec) / 1.0e9);
+  rate = (secs > 0.0) ? (wp->bytes / secs) : 0.0;
+  lineRate = (float64)mapBaudRate(spdp->lbrp->baudRate) / bitsPerByte;
+
+  spdp->lbrp->rxOK += wp->ok;
+  spdp->lbrp->rxNG += wp->drop + wp->ooo + wp->bad;
+
+  fitPrint(LOG, "                         %s->%s BAUD %6lu WINDOW %3lu FRAMES %6lu OK %6lu " \
+           "DROP %6lu OOO %6lu BAD %6lu %8.1f B/S %5.1f%%\n",spdp->devName_w,spdp->devName_r,
+           mapBaudRate(spdp->lbrp->baudRate),spWindow,wp->total,wp->ok,wp->drop,wp->ooo,
+           wp->bad,rate,(rate * 100.0) / lineRate);
+
+  if ((ret == ftPass) && ((wp->drop != 0u) || (wp->ooo != 0u) || (wp->bad != 0u))) {
+    ret = ftRxFail;
+  }
+
+  if (ftRecording ()) {
+    memset (&rec,0,sizeof(rec));
+    rec.test   = "serial";
+    rec.event  = "window";
+    rec.rx     = spdp->devName_r;
+    rec.tx     = spdp->devName_w;
+    rec.baud   = mapBaudRate (spdp->lbrp->baudRate);
+    rec.result = ret;
+    rec.okCnt  = wp->ok;
+    rec.ngCnt  = wp->drop + wp->ooo + wp->bad;
+    rec.start  = start;
+    rec.end    = end;
+    ftRecord (&rec);
+  }
+
+  if (ret != ftPass) {
+    ret = ftUpdateTestStatus(ftrp,ret,NULL);
+  }
+
+  return (ret);
+}
+
+/*
+*
+* Get concurrent test
+*
+*/
+
+static spDatDat_t *getConcurrentTest(const spDatDat_t *spdp)
+{
+  spDatDat_t *lspdp;
+
+  for (lspdp = spDatDat; lspdp != NULL; lspdp = lspdp->next) {
+    if (lspdp == spdp) {
+      continue;
+    }
+
+    if ((lspdp->id_r == spdp->id_w) && (lspdp->id_w == spdp->id_r)) {
+      /*
+      * found a running concurrent test
+      */
+      return (lspdp);
+    }
+  }
+
+  //return ((spDatDat_t *)0);
+  return (NULL);
+}
+
+/*
+*
+* Add the latency of a good frame to the histograms of its baud rate and
+* frame size, in microseconds
+*
+*/
+
+static void spAddLatency (bRate_t *brp,const bRateMsmnt_t *lbrmp)
+{
+  int32 usec;
+
+  usec = ((int32)(lbrmp->end.tv_sec - lbrmp->start.tv_sec) * 1000000) +
+         (int32)((lbrmp->end.tv_nsec - lbrmp->start.tv_nsec) / 1000);
+
+  ftHistAdd (brp->brhp,(u_int32)MAX(usec,0));
+  ftHistCAdd (&brp->brszp[lbrmp - brp->brmp],(u_int32)MAX(usec,0));
+}
+
+/*
+*
+* Write the structured result of one frame, see fit -R
+*
+*/
+
+static void spRecordFrame (const spDatDat_t *spdp,bRateMsmnt_t *lbrmp,ftRet_t ret)
+{
+  ftRecord_t rec;
+
+  if (ret != ftPass) {
+    clock_gettime (CLOCK_MONOTONIC, &lbrmp->end); // the receiver gave up here
+  }
+
+  memset (&rec,0,sizeof(rec));
+  rec.test   = "serial";
+  rec.rx     = spdp->devName_r;
+  rec.tx     = spdp->devName_w;
+  rec.baud   = mapBaudRate (spdp->lbrp->baudRate);
+  rec.size   = spdp->comSz;
+  rec.result = ret;
+  rec.start  = lbrmp->start;
+  rec.end    = lbrmp->end;
+  ftRecord (&rec);
+}
+
+/*
+* Write the frame of a stop and wait test
+*/
+static ftRet_t spTxFrame (spDatDat_t *spdp)
+{
+  ssize_t bCnt;
+  ftRet_t ret;
+
+  bCnt = write(spdp->fd_w,spdp->buf_w,spdp->comSz);
+
+  if(bCnt == -1) {
+    fitPrint(ERROR, "%s cannot write from %s, err %d, %s, fd %ld, sz %4.4u\n",
+             spdp->testName,spdp->devName_w,errno,strerror(errno),spdp->fd_w,spdp->comSz);
+    spdp->lbrp->txNG++;
+    ret = ftUpdateTestStatus(ftrp,ftTxError,NULL);
+  } else {
+    if ((size_t)bCnt != spdp->comSz) {
+      fitPrint(ERROR, "%s info, %s returned write byte count %4.4d, expected %4.4u, " \
+               "baud %lu\n",spdp->testName,spdp->devName_w,bCnt,spdp->comSz,
+               mapBaudRate(spdp->lbrp->baudRate));
+      if ((rxType != 2u) && (rxType != 4u)) {
+        spdp->lbrp->txNG++; // Frame did not transmit properly.
+        ret = ftUpdateTestStatus(ftrp,ftTxFail,NULL);
+      } else {
+        // Frame has been successfully transmitted.
+        // A type two or four receiver can put the correct frame together.
+        spdp->lbrp->txOK++;
+        ret = ftUpdateTestStatus(ftrp,ftPass,NULL);
+      }
+    } else {
+      // Frame has been successfully transmitted.
+      spdp->lbrp->txOK++;
+      ret = ftUpdateTestStatus(ftrp,ftPass,NULL);
+    }
+  }
+
+  return (ret);
+}
+
+/*
+*
+* Check whether a test runs at a baud rate
+*
+*/
+
+static bool spRateUsable (const spDatDat_t *spdp,const bRate_t *brp)
+{
+  // command line baud rate overide
+  if ((baudRateOveride != 0u) && (baudRateOveride != mapBaudRate(brp->baudRate))) {
+    return (false);
+  }
+
+  /*
+  * SP3S and SP5S only support two high data rates
+  * that are shared. The slowest can also be shared
+  * with the fastest rate on the other synchronous ports.
+  */
+  if ((spdp->protocol == protSync) &&
+      (spPorts[spdp->id_r].shared != spPorts[spdp->id_w].shared) &&
+      (brp->baudRate != 153600u)) {
+    return (false);
+  }
+
+  return (true);
+}
+
+/*
+*
+* Sweep planner, see -s and -n
+*
+* Every usable baud rate of a cable is one job that runs the tests of both
+* directions. Jobs are placed longest first, each into the first round it
+* does not conflict with. Two jobs conflict when they use the same port,
+* since a port runs one baud rate at a time, or when both use a shared
+* clock port at different baud rates. A job in a later round therefore
+* conflicts with every earlier round, no round can take another job.
+*
+*/
+
+static spJob_t *spJobs = NULL;     // planned jobs, longest first
+static u_int32  spJobCnt = 0u;
+static u_int32  spRounds = 0u;     // 0 runs every test at once, sweeping its baud rates
+static bool     spPlanned = false; // run the planned rounds
+static bool     spDryRun = false;  // print the plan, do not test
+
+/*
+* Estimated seconds on the wire for the frames of a test at one baud rate
+*/
+static float64 spWireTime (const spDatDat_t *spdp,speed_t baudRate)
+{
+  const float64 bitsPerByte = (spdp->protocol == protAsync) ? 10.0 : 8.0;
+  float64 bytes;
+
+  bytes = ((float64)(spdp->minFrameSize + spdp->maxFrameSize) *
+           (float64)((spdp->maxFrameSize - spdp->minFrameSize) + 1u)) / 2.0;
 
-  return (ret);
+  return ((bytes * (float64)spdp->iter * bitsPerByte) / (float64)mapBaudRate (baudRate));
 }
 
-/*
-*
-* Receiver Type 2
-*
-* packet may be assembled from fragmented frames
-*
-*/
-static ftRet_t rxTypeTwo (const spDatDat_t *spdp,bRateMsmnt_t *lbrmp)
+static bool spJobConflict (const spJob_t *a,const spJob_t *b)
 {
-  int32 reTry=0, bCnt, i;
-  char *cp = spdp->buf_r;
-  ftRet_t ret = ftFail;
-  fd_set rfds;
-  struct timeval tv;
-  int32 retval;
+  if ((a->ports & b->ports) != 0u) {
+    return (true);
+  }
 
-  FD_ZERO(&rfds);
-  FD_SET(spdp->fd_r, &rfds);
-  i=(int32)spdp->comSz;
+  return (a->shared && b->shared && (a->brp[0]->baudRate != b->brp[0]->baudRate));
+}
 
-eagain2:
-  bCnt = -1;
-  calculateTimeout (spdp, &tv);
-  retval = select (spdp->fd_r + 1, &rfds, NULL, NULL, &tv);
+static int32 spPlan (void)
+{
+  spDatDat_t *spdp, *spdp_c;
+  spJob_t    *jp;
+  spJob_t     job;
+  bRate_t    *brp, *brp_c;
+  u_int32     i, j, cnt = 0u;
+
+  for (spdp = spDatDat; spdp != NULL; spdp = spdp->next) {
+    cnt++;
+  }
 
-  if (retval == 0)
-  {
-    // Select timed out
-    fitPrint(VERBOSE, "%s timed out reading from %s, fd %ld, sz %4.4u, baud %lu\n",
-             spdp->testName,spdp->devName_r,spdp->fd_r,spdp->comSz,
-             mapBaudRate(spdp->lbrp->baudRate));
-    spdp->lbrp->rxNG++;
-    ret = ftUpdateTestStatus(ftrp,ftRxTimeout,NULL);
+  spJobs = calloc (cnt * SP_MAX_RATES,sizeof(spJob_t));
+  if (spJobs == NULL) {
+    fitPrint(ERROR, "cannot allocate the sweep plan of %lu tests\n",cnt);
+    return (-1);
   }
-  else if ((retval == -1) || ((bCnt = read (spdp->fd_r,cp,(size_t)i)) == -1))
-  {
-    if (EAGAIN == errno) {
-      if (++reTry > RETRY_CNT) {
-        fitPrint(VERBOSE, "%s nothing to read, err %d\n",spdp->testName,errno);
-      } else {
-        goto eagain2;
-      }
+
+  for (spdp = spDatDat; spdp != NULL; spdp = spdp->next) {
+    if (spdp->spLock != &((spDesc_t *)spdp)->lock) { //lint !e740 dat is the first member
+      continue; // the other direction of the cable has the jobs
     }
-    fitPrint(VERBOSE, "%s cannot read from %s, err %d, %s, fd %ld, sz %4.4u, baud %lu\n",
-             spdp->testName,spdp->devName_r,errno,strerror(errno),spdp->fd_r,spdp->comSz,
-             mapBaudRate(spdp->lbrp->baudRate));
-    spdp->lbrp->rxNG++;
-    ret = ftUpdateTestStatus(ftrp,ftRxError,NULL);
-  }
-  else
-  {
-    if (bCnt != i)
-    {
-      if (rxType != 2u)
-      {
-        fitPrint(VERBOSE, "%s %s returned read byte count %ld, expected %ld, baud %lu\n",
-                 spdp->testName,spdp->devName_r,bCnt,i,mapBaudRate(spdp->lbrp->baudRate));
-      }
 
-      /*
-      * Check for partial successful read. Update request and pointers.
-      */
-      if ((bCnt < i) && (bCnt != 0))
-      {
-        i -= bCnt;
-        cp = &cp[bCnt];
-        reTry = 0;
-        goto eagain2; // try to read the rest of the buffer
-      }
-      else
-      {
-        spdp->lbrp->rxNG++;
-        ret = ftUpdateTestStatus(ftrp,ftRxFail,NULL);
+    spdp_c = getConcurrentTest (spdp);
+
+    for (brp = spdp->brp; brp->baudRate != 0u; brp++) {
+      if (!spRateUsable (spdp,brp)) {
+        continue;
       }
-    } //if (bCnt != i)
-    else  //bCnt == i
-    {
-      /*
-      * Received a frame, check payload
-      */
 
-      clock_gettime(CLOCK_MONOTONIC, &lbrmp->end);   // end timing this frame
+      jp = &spJobs[spJobCnt++];
+      jp->spdp[0] = spdp;
+      jp->brp[0]  = brp;
+      jp->ports   = (1uL << spdp->id_r) | (1uL << spdp->id_w);
+      jp->shared  = spPorts[spdp->id_r].shared || spPorts[spdp->id_w].shared;
+      jp->wire    = spWireTime (spdp,brp->baudRate);
 
-      if (memcmp (spdp->buf_r,spdp->buf_w,spdp->comSz) == 0)
-      {
-        /*
-        * Frame has been successfully transmitted and received
-        */
-        spdp->lbrp->rxOK++;
-        ret = ftUpdateTestStatus(ftrp,ftPass,NULL);
-      } else {
-        spdp->lbrp->rxNG++;
-        ret = ftUpdateTestStatus(ftrp,ftRxFail,NULL);
-        fitPrint(VERBOSE, "\n%s test failed for %s rx, %s tx size %u, baud %lu\n",
-                 spdp->testName,spdp->devName_r,spdp->devName_w,spdp->comSz,
-                 mapBaudRate(spdp->lbrp->baudRate));
+      if (spdp_c == NULL) {
+        continue;
+      }
 
-        fitPrint(VERBOSE, "expected buffer (%p):",spdp->buf_w);
-#if 0
-        cp = spdp->buf_w;
-        for (i=0;i < spdp->comSz;i++) {
-          if (i%32 == 0) { // format output
-            fitPrint(VERBOSE, "\n");
-          }
-          fitPrint(VERBOSE, "%2.2x",*cp++);
+      for (brp_c = spdp_c->brp; brp_c->baudRate != 0u; brp_c++) {
+        if ((brp_c->baudRate == brp->baudRate) && spRateUsable (spdp_c,brp_c)) {
+          jp->spdp[1] = spdp_c; // full duplex, both directions share the round
+          jp->brp[1]  = brp_c;
+          jp->wire    = MAX(jp->wire,spWireTime (spdp_c,brp_c->baudRate));
+          break;
         }
-#else
-        mdmp(spdp->buf_w,spdp->comSz,VERBOSE);
-#endif
-        fitPrint(VERBOSE, "\nactual buffer   (%p):",spdp->buf_r);
-#if 0
-        cp = spdp->buf_r;
-        for (i=0;i<spdp->comSz;i++) {
-          if (i%32 == 0) { // format output
-            fitPrint(VERBOSE, "\n");
-          }
-          fitPrint(VERBOSE, "%2.2x",*cp++);
+      }
+    }
+  }
+
+  /*
+  * Longest first, then first fit
+  */
+  for (i = 1u; i < spJobCnt; i++) {
+    job = spJobs[i];
+    for (j = i; (j > 0u) && (spJobs[j - 1u].wire < job.wire); j--) {
+      spJobs[j] = spJobs[j - 1u];
+    }
+    spJobs[j] = job;
+  }
+
+  for (i = 0u; i < spJobCnt; i++) {
+    jp = &spJobs[i];
+    for (jp->round = 1u; ; jp->round++) {
+      for (j = 0u; j < i; j++) {
+        if ((spJobs[j].round == jp->round) && spJobConflict (jp,&spJobs[j])) {
+          break;
         }
-#else
-        mdmp(spdp->buf_r,spdp->comSz,VERBOSE);
-#endif
-        fitPrint(VERBOSE, "\n\n");
       }
-    }  //bCnt == i
+
+      if (j == i) {
+        break;
+      }
+    }
+
+    spRounds = MAX(spRounds,jp->round);
   }
 
-  return (ret);
+  return (0);
 }
 
 /*
-*
-* Get concurrent test
-*
+* Print the plan, returns the estimated wire time of all rounds
 */
-
-static const spDatDat_t *getConcurrentTest(const spDatDat_t *spdp)
+static float64 spPlanPrint (ftPrintLevels_t level)
 {
-  const spDatDat_t *lspdp;
+  const spJob_t *jp;
+  u_int32  round, i;
+  float64  longest, total = 0.0, serial = 0.0;
 
-  for (lspdp = spDatDat; lspdp->testName != NULL; lspdp++) {
-    if ((lspdp->spSt_r == unscheduled) || (lspdp->spSt_w == unscheduled)) {
-      continue;
+  for (round = 1u; round <= spRounds; round++) {
+    longest = 0.0;
+
+    for (i = 0u; i < spJobCnt; i++) {
+      jp = &spJobs[i];
+      if (jp->round != round) {
+        continue;
+      }
+
+      fitPrint(level, "round %3lu %4s->%-4s %s BAUD %6lu %10.2f S\n",round,
+               jp->spdp[0]->devName_w,jp->spdp[0]->devName_r,
+               (jp->spdp[1] != NULL) ? "and back" : "        ",
+               mapBaudRate (jp->brp[0]->baudRate),jp->wire);
+      longest = MAX(longest,jp->wire);
+      serial += jp->wire;
     }
 
-    if (lspdp == spdp) {
+    total += longest;
+  }
+
+  fitPrint(level, "%lu jobs in %lu rounds, estimated wire time %.2f S, %.2f S one job at a time\n",
+           spJobCnt,spRounds,total,serial);
+
+  return (total);
+}
+
+/*
+* Select the tests and baud rates of a round, no-op without a plan
+*/
+static void spPlanRound (u_int32 round)
+{
+  spDatDat_t *spdp;
+  u_int32     i, k;
+
+  for (spdp = spDatDat; spdp != NULL; spdp = spdp->next) {
+    spdp->plan = NULL;
+  }
+
+  for (i = 0u; i < spJobCnt; i++) {
+    if (spJobs[i].round != round) {
       continue;
     }
 
-    //lint -e{9007} strcmp has no side effects
-    if ( (strcmp (lspdp->devName_r,spdp->devName_w) == 0) &&
-         (strcmp (lspdp->devName_w,spdp->devName_r) == 0)    ) {
-      /*
-      * found a running concurrent test
-      */
-      return (lspdp);
+    for (k = 0u; k < 2u; k++) {
+      if (spJobs[i].spdp[k] != NULL) {
+        spJobs[i].spdp[k]->plan = spJobs[i].brp[k];
+      }
     }
   }
+}
 
-  //return ((spDatDat_t *)0);
-  return (NULL);
+static bool spInRound (const spDatDat_t *spdp)
+{
+  return ((spRounds == 0u) || (spdp->plan != NULL));
 }
 
 /*
@@ -2243,11 +2771,8 @@ static const spDatDat_t *getConcurrentTest(const spDatDat_t *spdp)
 
 static ftRet_t spExtLpback(spDatDat_t *spdp,xfer_t xf)
 {
-  int32   reTry=0;
   int32   result;
-  ssize_t bCnt;
   size_t  comSize, iterCnt;
-  char    specialDevice[20]; // must be large enough
   const spDatDat_t   *lspdp;       // local serial port data pointer
   const spDatDat_t   *spdp_c;
   bRateMsmnt_t *lbrmp;       // local baud rate measurements pointer
@@ -2262,52 +2787,43 @@ static ftRet_t spExtLpback(spDatDat_t *spdp,xfer_t xf)
       */
 
       /*
-      * Construct RX special device name
-      */
-      specialDevice[0] = '\0';
-      strcat (specialDevice,"/dev/");
-      strcat (specialDevice,spdp->devName_r);
-
-      /*
-      * Open RX special device
+      * Open RX special device, it stays open until spFreeDat()
       */
-      spdp->fd_r = open (specialDevice,rxFlags);
-
       if (spdp->fd_r == -1) {
-        if (strcmp (spdp->devName_r,spdp->devName_w) == 0) {
-          fitPrint(ERROR, "%s test cannot open %s for read, err %d, %s\n",
-                   spdp->testName,specialDevice,errno,strerror(errno));
-          ret = ftUpdateTestStatus(ftrp,ftRxError,NULL);
-          return (ret);
-        }
+        spdp->fd_r = spOpen (spdp->devName_r,rxFlags);
 
-        /*
-        * RX and TX ports are different and may have been opened previously for TX.
-        */
-        for (lspdp = spDatDat; lspdp->testName != NULL; lspdp++) {
-          if ((lspdp->spSt_r == unscheduled) || (lspdp->spSt_w == unscheduled)) {
-            continue;
+        if (spdp->fd_r == -1) {
+          if (spdp->id_r == spdp->id_w) {
+            fitPrint(ERROR, "%s test cannot open %s for read, err %d, %s\n",
+                     spdp->testName,spdp->devName_r,errno,strerror(errno));
+            ret = ftUpdateTestStatus(ftrp,ftRxError,NULL);
+            return (ret);
           }
 
-          if (lspdp == spdp) {
-            continue;
-          }
+          /*
+          * RX and TX ports are different and may have been opened previously for TX.
+          */
+          for (lspdp = spDatDat; lspdp != NULL; lspdp = lspdp->next) {
+            if (lspdp == spdp) {
+              continue;
+            }
 
-          if (strcmp (spdp->devName_r,lspdp->devName_w) == 0) {
-            if (lspdp->fd_w > 0) {
-              /*
-              * Already opened for previous transmit open.
-              */
-              spdp->fd_r = lspdp->fd_w;
-              break;
+            if (spdp->id_r == lspdp->id_w) {
+              if (lspdp->fd_w > 0) {
+                /*
+                * Already opened for previous transmit open.
+                */
+                spdp->fd_r = lspdp->fd_w;
+                break;
+              }
             }
           }
-        }
 
-        if (spdp->fd_r == -1) {
-          fitPrint(ERROR, "%s test cannot find previous open %s for read, err %d, %s\n",
-                   spdp->testName,specialDevice,errno,strerror(errno));
-          return (ret);
+          if (spdp->fd_r == -1) {
+            fitPrint(ERROR, "%s test cannot find previous open %s for read, err %d, %s\n",
+                     spdp->testName,spdp->devName_r,errno,strerror(errno));
+            return (ret);
+          }
         }
       }
 
@@ -2316,33 +2832,24 @@ static ftRet_t spExtLpback(spDatDat_t *spdp,xfer_t xf)
       * The test will support loopback to the same device
       * or between two devices.
       */
-      if (strcmp (spdp->devName_r,spdp->devName_w) != 0) {
-        /*
-        * Construct TX special device name
-        */
-        specialDevice[0] = '\0';
-        strcat (specialDevice,"/dev/");
-        strcat (specialDevice,spdp->devName_w);
-
+      if (spdp->fd_w != -1) {
+        // still open from the previous iteration
+      } else if (spdp->id_r != spdp->id_w) {
         /*
         * Open TX special device
         */
-        spdp->fd_w = open (specialDevice,txFlags);
+        spdp->fd_w = spOpen (spdp->devName_w,txFlags);
 
         if (spdp->fd_w == -1) {
           /*
           * RX and TX ports are different and may have been opened previously for RX.
           */
-          for (lspdp = spDatDat; lspdp->testName != NULL; lspdp++) {
-            if ((spdp->spSt_r == unscheduled) || (spdp->spSt_w == unscheduled)) {
-              continue;
-            }
-
+          for (lspdp = spDatDat; lspdp != NULL; lspdp = lspdp->next) {
             if (lspdp == spdp) {
               continue;
             }
 
-            if (strcmp (spdp->devName_w,lspdp->devName_r) == 0) {
+            if (spdp->id_w == lspdp->id_r) {
               if (lspdp->fd_r > 0) {
                 /*
                 * Already opened for previous receive open.
@@ -2355,7 +2862,7 @@ static ftRet_t spExtLpback(spDatDat_t *spdp,xfer_t xf)
 
           if (spdp->fd_w == -1) {
             fitPrint(ERROR, "%s test cannot find previous open %s for write, err %d, %s\n",
-            spdp->testName,specialDevice,errno,strerror(errno));
+            spdp->testName,spdp->devName_w,errno,strerror(errno));
             ret = ftUpdateTestStatus(ftrp,ftTxError,NULL);
             return (ret);
           }
@@ -2364,6 +2871,10 @@ static ftRet_t spExtLpback(spDatDat_t *spdp,xfer_t xf)
         spdp->fd_w = spdp->fd_r; // single port loopback, share the device descriptor
       }
 
+      if ((rxType == 4u) && (spWindow == 0u) && (spReactorAdd (spdp) != 0)) {
+        return (ftUpdateTestStatus(ftrp,ftRxError,NULL));
+      }
+
   #if 0
       if (showParallelPorts) {
         get_pports ();
@@ -2377,11 +2888,12 @@ static ftRet_t spExtLpback(spDatDat_t *spdp,xfer_t xf)
       */
 
       for (spdp->lbrp = spdp->brp;spdp->lbrp->baudRate != 0u;spdp->lbrp++) {
-        // command line baud rate overide
-        if (baudRateOveride != 0u) {
-          if (baudRateOveride != mapBaudRate(spdp->lbrp->baudRate)) {
-            continue;
-          }
+        if (!spRateUsable (spdp,spdp->lbrp)) {
+          continue;
+        }
+
+        if ((spdp->plan != NULL) && (spdp->plan != spdp->lbrp)) {
+          continue; // planned for another round
         }
 
         switch (spdp->protocol) {
@@ -2389,38 +2901,6 @@ static ftRet_t spExtLpback(spDatDat_t *spdp,xfer_t xf)
             (void) fcntl (spdp->fd_r,F_SETFL,0/*FNDELAY*/); // useless?
             break;
           case protSync:
-            /*
-            * Enforce baud rate rules.
-            */
-            if (strcmp (spdp->devName_r,spdp->devName_w) != 0)
-            {
-              //lint -e{9007} strcmp has no side effects
-              if ((strcmp (spdp->devName_r,"sp3s") == 0) ||
-                  (strcmp (spdp->devName_r,"sp5s") == 0) ||
-                  (strcmp (spdp->devName_w,"sp3s") == 0) ||
-                  (strcmp (spdp->devName_w,"sp5s") == 0))
-              {
-                /*
-                * SP3S and SP5S only support two high data rates
-                * that are shared. The slowest can also be shared
-                * with the fastest rate on the other synchronous ports.
-                */
-                //lint -e{9007} strcmp has no side effects
-                if (!(((strcmp (spdp->devName_r,"sp3s") == 0) &&
-                       (strcmp (spdp->devName_w,"sp5s") == 0))||
-                      ((strcmp (spdp->devName_r,"sp5s") == 0) &&
-                       (strcmp (spdp->devName_w,"sp3s") == 0))))
-                {
-                  /*
-                  * The remaining serial ports share a single rate.
-                  */
-                  if (spdp->lbrp->baudRate != 153600u)
-                  {
-                    continue;
-                  }
-                }
-              }
-            }
             break;
           case protNone:
           default:
@@ -2449,6 +2929,10 @@ static ftRet_t spExtLpback(spDatDat_t *spdp,xfer_t xf)
 
           spdp_c = getConcurrentTest (spdp);
 
+          if ((spdp_c != NULL) && (spdp->plan != NULL) && (spdp_c->plan == NULL)) {
+            spdp_c = NULL; // the other direction is not in this round
+          }
+
           if (spdp_c != NULL) {
             /* there is a concurrent test scheduled */
             if (spdp_c->spSt_r == waitingForConcurrent) {
@@ -2484,6 +2968,14 @@ static ftRet_t spExtLpback(spDatDat_t *spdp,xfer_t xf)
           initSerialPort (spdp->fd_r, spdp->lbrp->baudRate, spdp->protocol, enableFlowControl);
         }
 
+        if (spWindow != 0u) {
+          ret = spWinRx (spdp); // the whole sweep of this baud rate as one stream
+          if ((ret != ftPass) && quickFail) {
+            break;
+          }
+          continue;
+        }
+
         /*
         *
         * Loop through requested iterations
@@ -2503,31 +2995,27 @@ static ftRet_t spExtLpback(spDatDat_t *spdp,xfer_t xf)
           {
             spdp->comSz = comSize;
 
-            memset (spdp->buf_r,0,spdp->comSz);           // initialize receive buffer to zeros
-            memset (spdp->buf_w,(plint)spdp->comSz,spdp->comSz); // iniz xsmit buf to packet size
+            spGenFrame (spdp); // transmit data, the receiver checks against the generator
 
-            //overlay ATC test string on first bytes of message
-            if (useAtcTestString)
-            {
-              memcpy (spdp->buf_w,atcTestString,MIN(spdp->comSz,sizeof(atcTestString)-1u));
-            }
+            if (spTxInline ()) {
+              spdp->spSt_r = receiving;
+              spRxArm (spdp); // the reactor owns the receive buffer from here
+              clock_gettime (CLOCK_MONOTONIC ,&lbrmp->start); // start timing this frame
+              (void) spTxFrame (spdp); // a failed write times out below, as with the transmitter thread
+            } else {
+              if (spWaitForTx (spdp) != 0) { // wait for transmitter ready state
+                return (ftUpdateTestStatus(ftrp,ftTxTimeout,NULL));
+              }
 
-            for (reTry = 0; (spdp->spSt_w != waitingForRx) && (reTry < MAX_WAIT_FOR_TX);
-                 reTry++) // wait for transmitter ready state
-            {
-              usleep (10000); // Sleeps for a hundredth of a second
-            }
+              spdp->spSt_r = receiving;
 
-            if (reTry == MAX_WAIT_FOR_TX) {
-              fitPrint(ERROR, "receiver %s timeout transmitter %s, fd %ld, sz %4.4u, " \
-                       "baud %lu\n",spdp->devName_r,spdp->devName_w,spdp->fd_w,spdp->comSz,
-                       mapBaudRate(spdp->lbrp->baudRate));
-              return (ftUpdateTestStatus(ftrp,ftTxTimeout,NULL));
-            }
+              if (rxType == 4u) {
+                spRxArm (spdp); // reactor with flow control, see spTxInline()
+              }
 
-            spdp->spSt_r = receiving;
-            clock_gettime (CLOCK_MONOTONIC ,&lbrmp->start); // start timing this frame
-            sem_post (spdp->mp_w); // start transmitter UP semaphore
+              clock_gettime (CLOCK_MONOTONIC ,&lbrmp->start); // start timing this frame
+              sem_post (spdp->mp_w); // start transmitter UP semaphore
+            }
 
             /*
             *
@@ -2544,6 +3032,9 @@ static ftRet_t spExtLpback(spDatDat_t *spdp,xfer_t xf)
               case 2u:
                 ret  = rxTypeTwo (spdp,lbrmp);
                 break;
+              case 4u:
+                ret  = rxTypeFour (spdp,lbrmp);
+                break;
               case 3u:
                 /*
                 * Transmit only test
@@ -2556,6 +3047,20 @@ static ftRet_t spExtLpback(spDatDat_t *spdp,xfer_t xf)
                 break;
             } // switch(rxType)
 
+            if ((ret == ftPass) && (spdp->lbrp->brhp != NULL)) {
+              spAddLatency (spdp->lbrp,lbrmp);
+            }
+
+            if (ret == ftPass) {
+              spTmoUpdate (spdp,lbrmp);
+            } else if (rxType != 3u) {
+              spDrain (spdp); // resynchronize before the next frame
+            }
+
+            if (ftRecording ()) {
+              spRecordFrame (spdp,lbrmp,ret);
+            }
+
             if ((ret != ftPass) && quickFail)
             {
               break;
@@ -2590,37 +3095,13 @@ static ftRet_t spExtLpback(spDatDat_t *spdp,xfer_t xf)
 
       spdp->spSt_w = transmitting;
 
-      /*
-      * Transmit data
-      */
-      bCnt = write(spdp->fd_w,spdp->buf_w,spdp->comSz);
-
-      if(bCnt == -1) {
-        fitPrint(ERROR, "%s cannot write from %s, err %d, %s, fd %ld, sz %4.4u\n",
-                 spdp->testName,spdp->devName_w,errno,strerror(errno),spdp->fd_w,spdp->comSz);
-        spdp->lbrp->txNG++;
-        ret = ftUpdateTestStatus(ftrp,ftTxError,NULL);
-      } else {
-        if ((size_t)bCnt != spdp->comSz) {
-          fitPrint(ERROR, "%s info, %s returned write byte count %4.4d, expected %4.4u, " \
-                   "baud %lu\n",spdp->testName,spdp->devName_w,bCnt,spdp->comSz,
-                   mapBaudRate(spdp->lbrp->baudRate));
-          if (rxType != 2u) {
-            spdp->lbrp->txNG++; // Frame did not transmit properly.
-            ret = ftUpdateTestStatus(ftrp,ftTxFail,NULL);
-          } else {
-            // Frame has been successfully transmitted.
-            // A type two receiver can put the correct frame together.
-            spdp->lbrp->txOK++;
-            ret = ftUpdateTestStatus(ftrp,ftPass,NULL);
-          }
-        } else {
-          // Frame has been successfully transmitted.
-          spdp->lbrp->txOK++;
-          ret = ftUpdateTestStatus(ftrp,ftPass,NULL);
-        }
+      if (spWindow != 0u) {
+        ret = spWinTx (spdp); // stream until the receiver has the sweep
+        spdp->spSt_w = transmitComplete;
+        break;
       }
 
+      ret = spTxFrame (spdp);
       spdp->spSt_w = transmitComplete;
       break;
 
@@ -2654,10 +3135,15 @@ static void* serialPort_r (void *vp)
   {
     spdp->spSt_r = waitingForMon;
     sem_wait (spdp->mp_r);
+    if (spdp->quit) {
+      break; // see spStopDat()
+    }
     ret = spExtLpback (spdp,receiver); // run the test
+    spdp->spSt_r = waitingForMon; // idle before the monitor sees it, see spFreeDat()
     sem_post (spdp->mp); // wake up the test monitor
   }
-  // never actually gets here
+
+  return (NULL);
 }
 
 /*
@@ -2680,28 +3166,65 @@ static void* serialPort_w (void *vp)
   while (true) // should ret be checked?
   {
     spdp->spSt_w = waitingForRx;
+    sem_post (&spdp->txRdy); // hand the port to the receiver
     sem_wait (spdp->mp_w);
+    if (spdp->quit) {
+      break; // see spStopDat()
+    }
     spdp->spSt_w = scheduled;
     ret = spExtLpback (spdp,transmitter);
   }
-  // never actually gets here
+
+  return (NULL);
+}
+
+/*
+* Start the transmitter thread of a descriptor, unless spTxInline()
+*/
+static int32 spStartTx(spDatDat_t *spdp)
+{
+  spDesc_t *dp = (spDesc_t *)spdp; //lint !e740 dat is the first member
+  int32 retVal;
+
+  if (dp->writer || spTxInline ()) {
+    return (0);
+  }
+
+  retVal = pthread_create (spdp->ptp_w,NULL,serialPort_w,spdp);
+  if (retVal != 0) {
+    fitPrint(ERROR, "can't pthread_create thread_id_w for %s, errno 0x%lx\n",
+             spdp->devName_w,retVal);
+    return (-1);
+  }
+
+  dp->writer = true;
+
+  return (0);
 }
 
 /*
-* Initialized serial port thread
+* Initialized serial port thread, a descriptor from the pool has them running.
+* The transmitter thread is started only when a test needs one.
 */
 static int32 initSpDat(spDatDat_t *spdp)
 {
+  spDesc_t *dp = (spDesc_t *)spdp; //lint !e740 dat is the first member
   int32 retVal;
 
-  for (spdp->lbrp = spdp->brp;spdp->lbrp->baudRate != 0u;spdp->lbrp++) {
-    spdp->lbrp->brmp = malloc (spdp->maxFrameSize * sizeof(bRateMsmnt_t));
+  spGenInit (&spdp->gen);
+
+  if (dp->workers) {
+    return (spStartTx (spdp));
   }
 
   sem_init (spdp->mp,0,0);     // binary semaphore for this serial port monitor
   sem_init (spdp->mp_r,0,0);   // binary semaphore for this serial port read thread
   sem_init (spdp->mp_w,0,0);   // binary semaphore for this serial port write thread
-  sem_init (spdp->spLock,0,0); // binary semaphore for this serial port concurrent tests
+  sem_init (&dp->lock,0,0);    // binary semaphore for concurrent tests, when this one owns it
+  sem_init (&spdp->txRdy,0,0);    // transmitter ready handoff
+  sem_init (&spdp->win.credit,0,0); // pipelined stream window
+  sem_init (&spdp->rxf.done,0,0); // receive reactor frame completion
+  pthread_mutex_init (&spdp->rxf.lock,NULL);
 
   retVal = pthread_create (spdp->ptp_r,NULL,serialPort_r,spdp);
   if (retVal != 0) {
@@ -2710,69 +3233,59 @@ static int32 initSpDat(spDatDat_t *spdp)
     return (-1);
   }
 
-  retVal = pthread_create (spdp->ptp_w,NULL,serialPort_w,spdp);
-  if (retVal != 0) {
-    fitPrint(ERROR, "can't pthread_create thread_id_w for %s, errno 0x%lx\n",
-             spdp->devName_w,retVal);
-    return (-1);
+  dp->workers = true;
+
+  if (!spPoolExit) {
+    spPoolExit = true;
+    (void) atexit (spPoolDrain);
   }
 
-  return (0);
+  return (spStartTx (spdp));
 }
 
 /*
-* Cancel serial port read/write threads
+* Stop the threads of a descriptor. They finish what they are doing, a
+* write included, and return when they see the quit flag.
 */
-static int32 cancelSpDat(spDatDat_t *spdp)
+static void spStopDat(spDatDat_t *spdp)
 {
+  spDesc_t *dp = (spDesc_t *)spdp; //lint !e740 dat is the first member
   int32 retVal;
-  void *res;
-
-  for (spdp->lbrp = spdp->brp;spdp->lbrp->baudRate != 0u;spdp->lbrp++) {
-    free (spdp->lbrp->brmp);
-  }
-
-  sem_destroy (spdp->spLock); // binary semaphore for this serial port concurrent tests
-  sem_destroy (spdp->mp_w);   // binary semaphore for this serial port write thread
-  sem_destroy (spdp->mp_r);   // binary semaphore for this serial port read thread
-  sem_destroy (spdp->mp);     // binary semaphore for this serial port monitor
 
-  retVal = pthread_cancel (*spdp->ptp_w);
-  if (retVal != 0) {
-    fitPrint (VERBOSE, "%s %s pthread_cancel write, ret %ld\n",
-              spdp->testName,spdp->devName_w,retVal);
-  }
-
-  retVal = pthread_join (*spdp->ptp_w,&res);
-  if (retVal != 0) {
-    fitPrint (VERBOSE, "%s %s pthread_join write, ret %ld\n",
-              spdp->testName,spdp->devName_w,retVal);
+  if (!dp->workers) {
+    return;
   }
 
-  if (res != PTHREAD_CANCELED) {
-    fitPrint(VERBOSE, "%s %s write thread was not cancelled\n",
-             spdp->testName,spdp->devName_w);
-  }
+  spdp->quit = true;
+  sem_post (spdp->mp_r);
 
-  // Cancelling read thread
-  retVal = pthread_cancel (*spdp->ptp_r);
-  if (retVal != 0) {
-    fitPrint (VERBOSE, "%s %s pthread_cancel read, ret %ld\n",
-              spdp->testName,spdp->devName_r,retVal);
+  if (dp->writer) {
+    sem_post (spdp->mp_w);
+    retVal = pthread_join (*spdp->ptp_w,NULL);
+    if (retVal != 0) {
+      fitPrint (VERBOSE, "%s %s pthread_join write, ret %ld\n",
+                spdp->testName,spdp->devName_w,retVal);
+    }
   }
 
-  retVal = pthread_join (*spdp->ptp_r,&res);
+  retVal = pthread_join (*spdp->ptp_r,NULL);
   if (retVal != 0) {
     fitPrint (VERBOSE, "%s %s pthread_join read, ret %ld\n",
               spdp->testName,spdp->devName_r,retVal);
   }
 
-  if (res != PTHREAD_CANCELED) {
-    fitPrint(VERBOSE, "%s %s read thread was not cancelled\n",
-             spdp->testName,spdp->devName_r);
-  }
+  sem_destroy (&dp->lock);
+  sem_destroy (&spdp->rxf.done);
+  sem_destroy (&spdp->txRdy);
+  sem_destroy (&spdp->win.credit);
+  pthread_mutex_destroy (&spdp->rxf.lock);
+  sem_destroy (spdp->mp_w);   // binary semaphore for this serial port write thread
+  sem_destroy (spdp->mp_r);   // binary semaphore for this serial port read thread
+  sem_destroy (spdp->mp);     // binary semaphore for this serial port monitor
 
-  return (0);
+  dp->workers = false;
+  dp->writer  = false;
+  spdp->quit  = false;
 }
 
 static void usage(char * cp)
@@ -2797,6 +3310,7 @@ sp1 sp2 128 256 4\n\
 \n\
 The number of lines is arbitrary and lines beginning with # are comments.\n\
 Ports are linux special device basenames. The dev dirname is presumed.\n\
+Any two asynchronous or any two synchronous ports can be paired.\n\
 Two posix threads are created for each line, one for recieve and one for\n\
 transmit. For each baud rate, packets are transmitted starting from a\n\
 minimum payload size up to the specified maximum payload size. The payload\n\
@@ -2810,6 +3324,20 @@ The arguments and functionality are defined as:\n\
 \t-m monitor loop behavior where parameter 0 specifies scrolling status,\n\
 \t   1 specifies wait and unblock and 2 specifies wait and block.\n\
 \t-q quick fail mode.\n\
+\t-s plans the sweep. Each baud rate of a cable is a job and jobs that share\n\
+\t   no port run concurrently in rounds. The shared clock ports only share a\n\
+\t   round at the same baud rate.\n\
+\t-n prints the sweep plan and its estimated wire time without testing.\n\
+\t-x receiver design, 2 (default) select per read, 4 single epoll reactor\n\
+\t   reading every port, a test then writes its frames without a transmitter\n\
+\t   thread unless -f is given.\n\
+\t-g payload pattern: size (default), atc, count, prbs7, prbs15, prbs23 or\n\
+\t   random[:seed]. Frames are checked as they arrive and a failure reports\n\
+\t   the first bad bit.\n\
+\t-w streams each sweep with up to this many sequence numbered frames in\n\
+\t   flight and reports throughput, drops and reordering per baud rate.\n\
+\t-y receive timeout as a fixed multiple of the frame wire time. By default\n\
+\t   the timeout follows the latency measured on each port pair and baud rate.\n\
 \t-c configuration file name\n\
 \t-h this help\n\
 ";
@@ -2824,14 +3352,267 @@ The arguments and functionality are defined as:\n\
 *
 */
 
+/*
+*
+* Descriptor pool
+*
+* A descriptor and its two threads outlive the invocation that configured
+* them. spFreeDat() parks idle descriptors in spPool with their threads
+* blocked on their semaphores. The next invocation that configures the
+* same port pair and frame sizes takes the descriptor back and resets it
+* in place. Nothing is allocated and no thread is created.
+*
+*/
+
+/*
+* Reset the statistics of a pooled descriptor for another invocation
+*/
+static void spResetDat (spDesc_t *dp,u_int32 iterCnt)
+{
+  spDatDat_t   *spdp = &dp->dat;
+  bRate_t      *brp;
+
+  for (brp = dp->br; brp->baudRate != 0u; brp++) {
+    brp->rxOK = 0u;
+    brp->rxNG = 0u;
+    brp->txOK = 0u;
+    brp->txNG = 0u;
+    brp->tmoN = 0u; // the ports are opened again, learn their latency again
+  }
+
+  memset (&dp[1],0,dp->len - sizeof(spDesc_t)); // histograms and frame timings
+
+  while (sem_trywait (spdp->mp) == 0) {
+    // a post the monitor did not wait for, see waitAndUnblock
+  }
+
+  while (sem_trywait (&dp->lock) == 0) {
+    // the cable may be paired differently this time
+  }
+
+  spdp->comSz  = 0u;
+  spdp->iter   = iterCnt;
+  spdp->lbrp   = NULL;
+  spdp->plan   = NULL;
+  spdp->spLock = &dp->lock;
+  spdp->next   = NULL;
+  memset (&spdp->chk,0,sizeof(spdp->chk));
+}
+
+/*
+* Take a descriptor from the pool, NULL if there is none for this test
+*/
+static spDatDat_t *spPoolTake (int32 id_r,int32 id_w,size_t minFrameSize,
+                               size_t maxFrameSize,u_int32 iterCnt)
+{
+  spDatDat_t **spdpp;
+  spDatDat_t  *spdp;
+
+  for (spdpp = &spPool; *spdpp != NULL; spdpp = &(*spdpp)->next) {
+    if (((*spdpp)->id_r == id_r) && ((*spdpp)->id_w == id_w)) {
+      break;
+    }
+  }
+
+  spdp = *spdpp;
+  if (spdp == NULL) {
+    return (NULL);
+  }
+
+  *spdpp = spdp->next;
+
+  if ((spdp->minFrameSize != minFrameSize) || (spdp->maxFrameSize != maxFrameSize)) {
+    spStopDat (spdp); // the arena does not fit these frame sizes
+    free (spdp);
+    return (NULL);
+  }
+
+  spResetDat ((spDesc_t *)spdp,iterCnt); //lint !e740 dat is the first member
+  return (spdp);
+}
+
+/*
+* Stop every pooled descriptor, at exit
+*/
+static void spPoolDrain (void)
+{
+  spDatDat_t *spdp;
+
+  while (spPool != NULL) {
+    spdp = spPool;
+    spPool = spdp->next;
+    spStopDat (spdp);
+    free (spdp); // dat is the first member of spDesc_t
+  }
+}
+
+/*
+* Allocate the descriptor of a test from id_r to id_w
+*
+* The descriptor, its buffers, baud rate statistics, frame timings and
+* latency histograms are one cache line aligned allocation.
+*/
+static spDatDat_t *spAllocDat (int32 id_r,int32 id_w,size_t minFrameSize,
+                               size_t maxFrameSize,u_int32 iterCnt)
+{
+  spDesc_t         *dp;
+  spDatDat_t       *spdp;
+  ftHist_t         *hp;
+  ftHistC_t        *szp;
+  bRateMsmnt_t     *mp;
+  void             *vp;
+  const speed_t    *rates = spPorts[id_r].rates;
+  size_t            nRates, nSz, len, i;
+
+  for (nRates = 0; (rates[nRates] != 0u) && (nRates < SP_MAX_RATES); nRates++) {
+    // count the baud rates of the receiver
+  }
+
+  nSz = maxFrameSize - minFrameSize + 1u;
+  len = sizeof(spDesc_t) + (nRates * (sizeof(ftHist_t) + (nSz * sizeof(ftHistC_t)) +
+                                      (maxFrameSize * sizeof(bRateMsmnt_t))));
+
+  if (posix_memalign (&vp,FT_CACHE_LINE,len) != 0) {
+    fitPrint(ERROR, "cannot allocate %u bytes for %s->%s\n",len,spPorts[id_w].name,
+             spPorts[id_r].name);
+    return (NULL);
+  }
+
+  memset (vp,0,len);
+  dp   = vp;
+  dp->len = len;
+  spdp = &dp->dat;
+  hp   = (ftHist_t *)&dp[1];         // spDesc_t is a multiple of the cache line
+  szp  = (ftHistC_t *)&hp[nRates];
+  mp   = (bRateMsmnt_t *)&szp[nRates * nSz];
+
+  spdp->testName     = (spPorts[id_r].protocol == protSync) ? "SyncExtLoopback" : "AsyncExtLoopback";
+  spdp->devName_r    = spPorts[id_r].name;
+  spdp->devName_w    = spPorts[id_w].name;
+  spdp->id_r         = id_r;
+  spdp->id_w         = id_w;
+  spdp->mp           = &dp->mon;
+  spdp->mp_r         = &dp->sem_r;
+  spdp->mp_w         = &dp->sem_w;
+  spdp->spLock       = &dp->lock;
+  spdp->ptp_r        = &dp->tid_r;
+  spdp->ptp_w        = &dp->tid_w;
+  spdp->buf_r        = dp->buf_r;
+  spdp->buf_w        = dp->buf_w;
+  spdp->minFrameSize = minFrameSize;
+  spdp->maxFrameSize = maxFrameSize;
+  spdp->iter         = iterCnt;
+  spdp->protocol     = spPorts[id_r].protocol;
+  spdp->fd_r         = -1;
+  spdp->fd_w         = -1;
+  spdp->spSt_r       = scheduled;
+  spdp->spSt_w       = scheduled;
+  spdp->brp          = dp->br;
+
+  for (i = 0; i < nRates; i++) {
+    dp->br[i].baudRate = rates[i];
+    dp->br[i].brhp     = &hp[i];
+    dp->br[i].brszp    = &szp[i * nSz];
+    dp->br[i].brmp     = &mp[i * maxFrameSize];
+  }
+
+  return (spdp);
+}
+
+/*
+* Descriptor of a test from id_r to id_w, from the pool or newly allocated
+*/
+static spDatDat_t *spNewDat (int32 id_r,int32 id_w,size_t minFrameSize,
+                             size_t maxFrameSize,u_int32 iterCnt)
+{
+  spDatDat_t       *spdp;
+  const spDatDat_t *lspdp;
+
+  spdp = spPoolTake (id_r,id_w,minFrameSize,maxFrameSize,iterCnt);
+  if (spdp == NULL) {
+    spdp = spAllocDat (id_r,id_w,minFrameSize,maxFrameSize,iterCnt);
+  }
+
+  if (spdp == NULL) {
+    return (NULL);
+  }
+
+  /*
+  * The two directions of a cable coordinate baud rate changes with one lock
+  */
+  for (lspdp = spDatDat; lspdp != NULL; lspdp = lspdp->next) {
+    if ((lspdp->id_r == id_w) && (lspdp->id_w == id_r)) {
+      spdp->spLock = lspdp->spLock;
+      break;
+    }
+  }
+
+  return (spdp);
+}
+
+/*
+* Close a port, once for all tests that share its descriptor
+*/
+static void spClosePort (int32 fd)
+{
+  spDatDat_t *spdp;
+
+  if (fd < 0) {
+    return;
+  }
+
+  (void) tcflush (fd,TCOFLUSH); // release a writer held by flow control
+  (void) close (fd);
+
+  for (spdp = spDatDat; spdp != NULL; spdp = spdp->next) {
+    if (spdp->fd_r == fd) {
+      spdp->fd_r = -1;
+    }
+    if (spdp->fd_w == fd) {
+      spdp->fd_w = -1;
+    }
+  }
+}
+
+/*
+* Release the descriptors of all tests, idle ones go to the pool
+*/
+static void spFreeDat (void)
+{
+  spDatDat_t *spdp;
+
+  for (spdp = spDatDat; spdp != NULL; spdp = spdp->next) {
+    spClosePort (spdp->fd_r);
+    spClosePort (spdp->fd_w);
+  }
+
+  while (spDatDat != NULL) {
+    spdp = spDatDat;
+    spDatDat = spdp->next;
+
+    if (((spDesc_t *)spdp)->workers && (spdp->spSt_r != waitingForMon)) { //lint !e740 dat is the first member
+      spStopDat (spdp); // left behind by the monitor, see waitAndUnblock
+      free (spdp);
+    } else {
+      spdp->next = spPool;
+      spPool = spdp;
+    }
+  }
+
+  free (spJobs);
+  spJobs   = NULL;
+  spJobCnt = 0u;
+  spRounds = 0u;
+}
+
 static int32 spConfigDat (char *fn)
 {
   spDatDat_t *spdp;
+  spDatDat_t **spdpp;
   FILE *fp;
   char spDev_r[20],spDev_w[20]; // must be big enough
   size_t minFrameSize,maxFrameSize,iterCnt;
-  int32  isReadDevNameEq;
-  int32  isWriteDevNameEq;
+  int32  id_r, id_w;
 
 
   fp = fopen (fn,"r");
@@ -2846,38 +3627,53 @@ static int32 spConfigDat (char *fn)
       continue; // this is a comment in the config file
     }
 
+    id_r = spPortId (spDev_r);
+    id_w = spPortId (spDev_w);
+
+    if ((id_r < 0) || (id_w < 0)) {
+      fitPrint(ERROR, "warning: unknown serial port in %s %s, line ignored\n",spDev_r,spDev_w);
+      continue;
+    }
+
+    if (spPorts[id_r].protocol != spPorts[id_w].protocol) {
+      fitPrint(ERROR, "warning: %s and %s use different protocols, line ignored\n",
+               spDev_r,spDev_w);
+      continue;
+    }
+
     /*
-    * TODO: need configuration integrity and resource checks
+    * Find the end of the list, a port pair is only tested once
     */
-    for (spdp = spDatDat; spdp->testName != NULL; spdp++)
-    {
-      isReadDevNameEq  = strncmp (spdp->devName_r,spDev_r,sizeof(spDev_r));
-      isWriteDevNameEq = strncmp (spdp->devName_w,spDev_w,sizeof(spDev_w));
+    for (spdpp = &spDatDat; *spdpp != NULL; spdpp = &(*spdpp)->next) {
+      if (((*spdpp)->id_r == id_r) && ((*spdpp)->id_w == id_w)) {
+        break;
+      }
+    }
 
-      if ((isReadDevNameEq == 0) && (isWriteDevNameEq == 0))
-      {
-        spdp->spSt_r = scheduled;
-        spdp->spSt_w = scheduled;
+    if (*spdpp != NULL) {
+      fitPrint(ERROR, "warning: %s %s is already configured, line ignored\n",spDev_r,spDev_w);
+      continue;
+    }
 
-        if ((minFrameSize <= MAX_TRANSFER) && (minFrameSize > 0u)) {
-          spdp->minFrameSize = minFrameSize;
-        } else {
-          spdp->minFrameSize = MIN(minFrameSize,MAX_TRANSFER);
-          fitPrint(ERROR, "warning: request for minimum frame size %u out of range, " \
-                   "using default %u bytes\n",minFrameSize,spdp->minFrameSize);
-        }
+    if ((minFrameSize > MAX_TRANSFER) || (minFrameSize == 0u)) {
+      fitPrint(ERROR, "warning: request for minimum frame size %u out of range, " \
+               "using default %u bytes\n",minFrameSize,MIN(minFrameSize,MAX_TRANSFER));
+      minFrameSize = MIN(minFrameSize,MAX_TRANSFER);
+    }
 
-        if ((maxFrameSize <= MAX_TRANSFER) && (maxFrameSize > 0u)) {
-          spdp->maxFrameSize = maxFrameSize;
-        } else {
-          spdp->maxFrameSize = MIN(maxFrameSize,MAX_TRANSFER);
-          fitPrint(ERROR, "warning: request for maximum frame size %u out of range, " \
-                   "using default %u bytes\n",maxFrameSize,spdp->maxFrameSize);
-        }
+    if ((maxFrameSize > MAX_TRANSFER) || (maxFrameSize == 0u)) {
+      fitPrint(ERROR, "warning: request for maximum frame size %u out of range, " \
+               "using default %u bytes\n",maxFrameSize,MIN(maxFrameSize,MAX_TRANSFER));
+      maxFrameSize = MIN(maxFrameSize,MAX_TRANSFER);
+    }
 
-        spdp->iter = iterCnt;
-      }
+    spdp = spNewDat (id_r,id_w,minFrameSize,maxFrameSize,iterCnt);
+    if (spdp == NULL) {
+      fclose (fp);
+      return (-1);
     }
+
+    *spdpp = spdp; // tests run in the order of the configuration file
   }
 
   fclose (fp);
@@ -2903,11 +3699,7 @@ static void printSerialStats (void)
   #endif
 
   // Print out info for each test running
-  for (spdp = spDatDat; spdp->testName != NULL; spdp++) {
-    if ((spdp->spSt_r == unscheduled) || (spdp->spSt_w == unscheduled)) {
-      continue;
-    }
-
+  for (spdp = spDatDat; spdp != NULL; spdp = spdp->next) {
     fitPrint(VERBOSE, "\n%s->%s:\n", spdp->devName_w, spdp->devName_r);
     fitPrint(VERBOSE, "\t%lu iterations from %u to %u bytes\n",
              spdp->iter, spdp->minFrameSize, spdp->maxFrameSize);
@@ -2916,6 +3708,10 @@ static void printSerialStats (void)
       fitPrint(VERBOSE, "\tATC test string used for first %u bytes\n",
                sizeof(atcTestString)-1u);
     }
+    else if (spPattern != patSize)
+    {
+      fitPrint(VERBOSE, "\t%s pattern used for all data bytes\n",spPatNames[spPattern]);
+    }
     else
     {
       fitPrint(VERBOSE, "\tmessage size used for all data bytes\n");
@@ -2941,6 +3737,57 @@ static void printSerialStats (void)
   #endif
 }
 
+/*
+*
+* Frame latency histograms per baud rate and frame size. Latency runs
+* from the receiver releasing the transmitter to the last byte read. The
+* throughput of the mean frame is compared with the line rate, 8N1 for
+* asynchronous and payload bits only for synchronous ports.
+*
+*/
+static void printLatencyStats (const spDatDat_t *spdp)
+{
+  const bRate_t   *brPtr;
+  const ftHistC_t *hp;
+  const ftHist_t  *all;
+  size_t   sz, nSz;
+  u_int32  baud;
+  float64  lineRate, effRate;
+  const float64 bitsPerByte = (spdp->protocol == protAsync) ? 10.0 : 8.0;
+
+  nSz = spdp->maxFrameSize - spdp->minFrameSize + 1u;
+
+  for (brPtr = spdp->brp; brPtr->baudRate != 0u; brPtr++) {
+    if (brPtr->brhp == NULL) {
+      continue;
+    }
+
+    baud = mapBaudRate (brPtr->baudRate);
+    lineRate = (float64)baud / bitsPerByte; // bytes per second
+    all = brPtr->brhp;
+
+    for (sz = 0u; sz < nSz; sz++) {
+      hp = &brPtr->brszp[sz];
+      if (hp->n == 0u) {
+        continue;
+      }
+
+      effRate = ((float64)(spdp->minFrameSize + sz) * 1.0e6) / (hp->sum / (float64)hp->n);
+
+      fitPrint(VERBOSE, "%s->%s BAUD %6lu SIZE %4u N %6lu P50 %8lu P99 %8lu P999 %8lu " \
+               "MAX %8lu US %8.1f B/S %5.1f%%\n",spdp->devName_w,spdp->devName_r,baud,
+               spdp->minFrameSize + sz,hp->n,ftHistCPct(hp,0.5),ftHistCPct(hp,0.99),
+               ftHistCPct(hp,0.999),hp->max,effRate,(effRate * 100.0) / lineRate);
+    }
+
+    if (all->n != 0u) {
+      fitPrint(LOG, "                         %s->%s BAUD %6lu N %6lu P50 %8lu P99 %8lu " \
+               "P999 %8lu MAX %8lu US\n",spdp->devName_w,spdp->devName_r,baud,all->n,
+               ftHistPct(all,0.5),ftHistPct(all,0.99),ftHistPct(all,0.999),all->max);
+    }
+  }
+}
+
 /*
 *
 * Entry function for Serial Port Tests
@@ -2957,9 +3804,11 @@ ftRet_t serialFit(plint argc, char * const argv[])
   ftRet_t  ftRet = ftError;
 
   int32 c, idx, waits = 1;
+  u_int32 round = 0u; // planned round, see -s
+  u_int32 cfgApplied, cfgAvoided;
   char errorStr[MUST_BE_BIG_ENOUGH] = {'\0'};
   char tempStr[MUST_BE_BIG_ENOUGH] = {'\0'};
-  const char *flagOpts = "-afqzm:b:hc:i:x:r:t:y:";
+  const char *flagOpts = "-afqsnzm:b:hc:i:x:r:t:y:w:g:";
   struct timespec ts;
   time_t start_time, end_time;
 
@@ -2967,9 +3816,31 @@ ftRet_t serialFit(plint argc, char * const argv[])
 
   /*
   *
-  * Parse command line arguments
+  * Parse command line arguments, from the defaults as every run of a plan
+  * starts over
   *
   */
+  useAtcTestString = false;
+  enableFlowControl = false;
+  quickFail = false;
+  spPlanned = false;
+  spDryRun = false;
+#ifdef PARALLEL_PORTS
+  showParallelPorts = false;
+#endif
+#ifdef REMOTE_CONTROLLER
+  remoteController = false;
+#endif
+  baudRateOveride = 0;
+  monitorLoop = waitAndBlock;
+  rxFlags = O_RDWR;
+  txFlags = O_RDWR;
+  rxType = 2;
+  tmoMultiplier = 0;
+  spWindow = 0;
+  spPattern = patSize;
+  spSeed = 1u;
+
   opterr = 0;
   c = getopt (argc,argv,flagOpts);
 
@@ -2989,6 +3860,12 @@ ftRet_t serialFit(plint argc, char * const argv[])
       case 'q': // fail test quickly
         quickFail = true;
         break;
+      case 's': // run the sweep plan
+        spPlanned = true;
+        break;
+      case 'n': // print the sweep plan only
+        spDryRun = true;
+        break;
 #ifdef PARALLEL_PORTS
       case 'p': // display parallel port programming
         showParallelPorts = true;
@@ -3036,6 +3913,18 @@ ftRet_t serialFit(plint argc, char * const argv[])
       case 'y': // timeout multiplier
         tmoMultiplier = strtol(optarg,NULL,10);
         break;
+      case 'w': // frames in flight, pipelined mode
+        spWindow = strtoul(optarg,NULL,10);
+        break;
+      case 'g': // payload pattern
+        if (spPatternOf (optarg) != 0) {
+          fitPrint(ERROR, "unknown payload pattern %s\n",optarg);
+          usage(argv[0]);
+          ftUpdateTestStatus(ftrp,ftError,NULL);
+          ftRet = ftUpdateTestStatus(ftrp,ftComplete,NULL);
+          loopAbort = true;
+        }
+        break;
         #ifdef REMOTE_CONTROLLER
       case 'z': // relay to interconnected controller
         remoteController = true;
@@ -3065,6 +3954,7 @@ ftRet_t serialFit(plint argc, char * const argv[])
 
   if (loopAbort)
   {
+    spFreeDat ();
     return ftRet;  // user help request or command line error
   }
 
@@ -3073,19 +3963,41 @@ ftRet_t serialFit(plint argc, char * const argv[])
     usage(argv[0]);
   }
 
+  ftArgsDone();
+
+  if ((spPlanned || spDryRun) && (spPlan () != 0)) {
+    spFreeDat ();
+    ftUpdateTestStatus(ftrp,ftError,NULL);
+    return (ftUpdateTestStatus(ftrp,ftComplete,NULL));
+  }
+
+  if (spDryRun) {
+    (void) spPlanPrint (USER);
+    spFreeDat ();
+    return (ftUpdateTestStatus(ftrp,ftComplete,NULL));
+  }
+
+  if (spPlanned) {
+    (void) spPlanPrint (VERBOSE);
+  }
+
   /*
   *
   * Initialize and start serial port threads
   *
   */
 
-  for (spdp = spDatDat; spdp->testName != NULL; spdp++) {
-    if ((spdp->spSt_r == unscheduled) || (spdp->spSt_w == unscheduled)) {
-      continue;
-    }
+  if ((rxType == 4u) && (spReactorStart () != 0)) {
+    spFreeDat ();
+    ftUpdateTestStatus(ftrp,ftError,NULL);
+    return (ftUpdateTestStatus(ftrp,ftComplete,NULL));
+  }
 
+  for (spdp = spDatDat; spdp != NULL; spdp = spdp->next) {
     if (initSpDat (spdp) != 0) {
       fitPrint(VERBOSE, "%s not started, %s rx, %s tx\n",spdp->testName,spdp->devName_r,spdp->devName_w);
+      spReactorStop ();
+      spFreeDat ();
       return (ftUpdateTestStatus(ftrp,ftError,NULL));
     } else {
       //fitPrint(VERBOSE, "%s started, %s rx, %s tx\n",spdp->testName,spdp->devName_r,spdp->devName_w);
@@ -3102,16 +4014,17 @@ ftRet_t serialFit(plint argc, char * const argv[])
 
     /*
     *
-    * Start up the tests
+    * Start up the tests, all of them or those of the next planned round
     *
     */
 
-    for (spdp = spDatDat; spdp->testName != NULL; spdp++) {
-      if ((spdp->spSt_r == unscheduled) || (spdp->spSt_w == unscheduled)) {
-        continue;
-      }
+    round = (round % MAX(spRounds,1u)) + 1u;
+    spPlanRound (round);
 
-      sem_post (spdp->mp_r); // enable the receiver thread
+    for (spdp = spDatDat; spdp != NULL; spdp = spdp->next) {
+      if (spInRound (spdp)) {
+        sem_post (spdp->mp_r); // enable the receiver thread
+      }
     }
 
     /*
@@ -3120,135 +4033,118 @@ ftRet_t serialFit(plint argc, char * const argv[])
     *
     */
 
-    for (spdp = spDatDat; spdp->testName != NULL; spdp++) {
-      if ((spdp->spSt_r == unscheduled) || (spdp->spSt_w == unscheduled)) {
-        // do nothing
+    for (spdp = spDatDat; spdp != NULL; spdp = spdp->next) {
+      if (!spInRound (spdp)) {
+        continue;
       }
-      else
-      {
-        /*
-        * select monitor loop behavior
-        */
-        switch (monitorLoop) {
-          case waitAndScroll:
-            while (sem_trywait (spdp->mp) != 0)
-            {
-              c = usleep (10000); // Sleeps for a hundredth of a second
-              if ((waits % 1000) == 0) { // ten seconds
-                printSerialStats (); // Print out stats
-                waits = 1;
-              }
-              waits++;
+
+      /*
+      * select monitor loop behavior
+      */
+      switch (monitorLoop) {
+        case waitAndScroll:
+          while (sem_trywait (spdp->mp) != 0)
+          {
+            c = usleep (10000); // Sleeps for a hundredth of a second
+            if ((waits % 1000) == 0) { // ten seconds
+              printSerialStats (); // Print out stats
+              waits = 1;
             }
-            break;
-          case waitAndUnblock:
-            /*
-            *
-            * This optional block allows the monitor to unblock while the tests are running.
-            * For now, try to determine whether the test is making progress.
-            * The 'stuck' test conditions are apparently all fixed, but this may prove useful
-            * when bringing in new drivers.
-            *
-            */
-            while (true) {
-              clock_gettime(CLOCK_REALTIME,&ts);
-              ts.tv_sec += 2;
-
-              time(&start_time);
-              c = sem_timedwait(spdp->mp,&ts); // monitor semaphore for this test
-              time(&end_time);
-
-              if (c == -1) {
-                if (errno == ETIMEDOUT) {
-                  //fitPrint(VERBOSE,"sem_timedwait timed out %s after %d seconds\n",spdp->devName_r,end_time - start_time);
-                } else {
-                   perror("sem_timedwait");
-                }
+            waits++;
+          }
+          break;
+        case waitAndUnblock:
+          /*
+          *
+          * This optional block allows the monitor to unblock while the tests are running.
+          * For now, try to determine whether the test is making progress.
+          * The 'stuck' test conditions are apparently all fixed, but this may prove useful
+          * when bringing in new drivers.
+          *
+          */
+          while (true) {
+            clock_gettime(CLOCK_REALTIME,&ts);
+            ts.tv_sec += 2;
+
+            time(&start_time);
+            c = sem_timedwait(spdp->mp,&ts); // monitor semaphore for this test
+            time(&end_time);
+
+            if (c == -1) {
+              if (errno == ETIMEDOUT) {
+                //fitPrint(VERBOSE,"sem_timedwait timed out %s after %d seconds\n",spdp->devName_r,end_time - start_time);
               } else {
-                //fitPrint(VERBOSE,"sem_timedwait succeeded for receiver %s\n",spdp->devName_r);
-                break;
+                 perror("sem_timedwait");
               }
+            } else {
+              //fitPrint(VERBOSE,"sem_timedwait succeeded for receiver %s\n",spdp->devName_r);
+              break;
+            }
 
-              /*
-              * check if receiver thread is running
-              */
-              if (spdp->spSt_r == waitingForMon) {
-                //fitPrint(VERBOSE,"Monitor found receiver %s blocked\n",spdp->devName_r);
-                break;
+            /*
+            * check if receiver thread is running
+            */
+            if (spdp->spSt_r == waitingForMon) {
+              //fitPrint(VERBOSE,"Monitor found receiver %s blocked\n",spdp->devName_r);
+              break;
+            } else {
+              /* check that this thread is making progress */
+              if (memcmp (spdp,&spd,sizeof(spDatDat_t)) == 0) {
+                //fitPrint(VERBOSE,"Monitor found receiver %s stuck\n",spdp->devName_r);
+                break; /* no change -> no progress */
               } else {
-                /* check that this thread is making progress */
-                if (memcmp (spdp,&spd,sizeof(spDatDat_t)) == 0) {
-                  //fitPrint(VERBOSE,"Monitor found receiver %s stuck\n",spdp->devName_r);
-                  break; /* no change -> no progress */
-                } else {
-                  memcpy (&spd,spdp,sizeof(spDatDat_t));
-                  //fitPrint(VERBOSE,"Monitor found receiver %s running\n",spdp->devName_r);
-                  continue;
-                }
+                memcpy (&spd,spdp,sizeof(spDatDat_t));
+                //fitPrint(VERBOSE,"Monitor found receiver %s running\n",spdp->devName_r);
+                continue;
               }
             }
+          }
 
-            //fitPrint(VERBOSE,"Monitor leaving %s\n",spdp->devName_r);
-            break;
-          case waitAndBlock:
-          /*lint -fallthrough */
-          default:
-            //fitPrint(VERBOSE, "Monitor waiting for post from %-4s, sval %d, twait %d\n",spdp->devName_r,sval,abs(c));
-            sem_wait (spdp->mp);
-            //fitPrint(VERBOSE, "Monitor received post from %-4s\n",spdp->devName_r);
-            break;
-        } // switch()
-      } //*else
+          //fitPrint(VERBOSE,"Monitor leaving %s\n",spdp->devName_r);
+          break;
+        case waitAndBlock:
+        /*lint -fallthrough */
+        default:
+          //fitPrint(VERBOSE, "Monitor waiting for post from %-4s, sval %d, twait %d\n",spdp->devName_r,sval,abs(c));
+          sem_wait (spdp->mp);
+          //fitPrint(VERBOSE, "Monitor received post from %-4s\n",spdp->devName_r);
+          break;
+      } // switch()
     } // for()
 
-    --iter;
+    if (round == MAX(spRounds,1u)) {
+      --iter; // every round has run
+    }
   } while (keepGoing && (iter > 0));
 
   printSerialStats ();
 
+  spReactorStop (); // receivers are idle, no frame is armed
+
   /*
-  * Cancel serial port read/write threads
+  * The serial port read/write threads stay for the next invocation, see spPool
   */
-  for (spdp = spDatDat; spdp->testName != NULL; spdp++) {
-    if ((spdp->spSt_r == unscheduled) || (spdp->spSt_w == unscheduled)) {
-      continue;
-    }
-
-#if 0 // Don't want this print out for final product
-    {
-      double t_ns = 0;
-      bRateMsmnt_t *lbrmp; // local baud rate measurements pointer
-      /*
-      * Process frame timing data
-      */
-      //fitPrint(VERBOSE, "processing frame timing data\n");
-      for (spdp->lbrp = spdp->brp;spdp->lbrp->baudRate != 0;spdp->lbrp++) {
-        for (lbrmp = spdp->lbrp->brmp,iter = 0;iter < (spdp->maxFrameSize - spdp->minFrameSize);iter++,lbrmp++) {
-          lbrmp->end.tv_sec -= lbrmp->start.tv_sec;
-          lbrmp->end.tv_nsec -= lbrmp->start.tv_nsec;
-
-          if (lbrmp->end.tv_nsec < 0) {
-            lbrmp->end.tv_sec--;
-            lbrmp->end.tv_nsec += 1000000000;
-          }
-
-          t_ns = (double)(lbrmp->end.tv_sec *1.0e9 + lbrmp->end.tv_nsec);
-        }
-        fitPrint(VERBOSE, "BAUD %6.6d %-4s FRAME SIZE %4.4d NS %14.2f\n",mapBaudRate(spdp->lbrp->baudRate),spdp->devName_r,spdp->maxFrameSize,t_ns);
-      }
-    }
-#endif
-
-    //fitPrint(VERBOSE, "monitor is cancelling threads...\n");
-    if (cancelSpDat (spdp) != 0) {
-      fitPrint(VERBOSE, "%s not canceled\n",spdp->testName);
-    } else {
-      //fitPrint(VERBOSE, "%s cancelled for %s rx, %s tx\n",spdp->testName,spdp->devName_r,spdp->devName_w);
-    }
+  for (spdp = spDatDat; spdp != NULL; spdp = spdp->next) {
+    printLatencyStats (spdp);
 
 #if 1
     // Check for failures and add them to errorStr
     for (brPtr = &spdp->brp[0]; brPtr->baudRate != 0u; brPtr++) {
+      if ((brPtr->rxOK != 0u) || (brPtr->rxNG != 0u) || (brPtr->txNG != 0u)) {
+        ftRecord_t rec;
+
+        memset (&rec,0,sizeof(rec));
+        rec.test   = "serial";
+        rec.event  = "baud";
+        rec.rx     = spdp->devName_r;
+        rec.tx     = spdp->devName_w;
+        rec.baud   = mapBaudRate (brPtr->baudRate);
+        rec.result = ((brPtr->rxNG != 0u) || (brPtr->txNG != 0u)) ? ftFail : ftPass;
+        rec.okCnt  = brPtr->rxOK;
+        rec.ngCnt  = brPtr->rxNG + brPtr->txNG;
+        ftRecord (&rec); // per baud rate summary, see fit -R
+      }
+
       if ((brPtr->rxNG != 0u) || (brPtr->txNG != 0u)) {
         sprintf (tempStr, "%s->%s@%lu, ", spdp->devName_w, spdp->devName_r, mapBaudRate (brPtr->baudRate));
 
@@ -3268,5 +4164,11 @@ ftRet_t serialFit(plint argc, char * const argv[])
         sprintf (tempStr, "%s->%s@%d, ", spdp->devName_w, spdp->devName_r, mapBaudRate (brPtr->baudRate));
 #endif
 
+  spCfgStats (&cfgApplied,&cfgAvoided);
+  fitPrint(VERBOSE, "port configurations applied %lu, unchanged and skipped %lu\n",
+           cfgApplied,cfgAvoided);
+
+  spFreeDat ();
+
   return(ftUpdateTestStatus(ftrp,ftComplete, errorStr));
 }
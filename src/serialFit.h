@@ -26,7 +26,7 @@
 #define ASYNC_MAX_FRAME_SZ_1200 4
 #define ASYNC_MAX_FRAME_SZ 32
 #define ONE 1
-#define MAX_WAIT_FOR_TX 500
+#define MAX_WAIT_FOR_TX 5 // seconds the receiver waits for the transmitter
 #define MAX_TRANSFER 1024u // 1022 is the real maximum for SYNC, 32 for ASYNC
 #define RETRY_CNT 2
 
@@ -109,8 +109,70 @@ typedef struct _bRate {
   u_int32       txOK;
   u_int32       txNG;
   bRateMsmnt_t *brmp; // baud rate measurements pointer
+  ftHist_t     *brhp;  // frame latency histogram, all frame sizes
+  ftHistC_t    *brszp; // and one per frame size
+  float64       tmoMean; // latency beyond wire time, weighted average in microseconds
+  float64       tmoDev;  // and its weighted mean deviation
+  u_int32       tmoN;    // good frames averaged
 } bRate_t;
 
+/*
+* Frame being assembled by the receive reactor, see rxTypeFour()
+*/
+typedef struct _spRxFrame {
+  pthread_mutex_t lock;  // reactor against receiver timeout
+  sem_t           done;  // posted when the frame completes or fails
+  char           *cp;    // next byte of the receive buffer
+  size_t          want;  // bytes still expected
+  bool            armed; // the reactor may read into the buffer
+  int32           err;   // errno of a failed read, 0 if none
+  struct timespec end;   // arrival of the last byte
+} spRxFrame_t;
+
+/*
+* Payload patterns, see -g
+*/
+typedef enum _spPat {
+  patSize,   // every byte is the frame size, optionally behind the ATC string
+  patAtc,    // ATC 6.24 test string, repeated
+  patCount,  // incrementing counter
+  patPrbs7,  // x^7 + x^6 + 1
+  patPrbs15, // x^15 + x^14 + 1
+  patPrbs23, // x^23 + x^18 + 1
+  patRandom  // xorshift from a seed
+} spPat_t;
+
+/*
+* Payload generator, see spGenByte()
+*/
+typedef struct _spGen {
+  u_int32 state; // counter, shift register or random state, carried across frames
+  size_t  pos;   // byte offset in the frame
+} spGen_t;
+
+/*
+* Streaming payload check, see spCheckBytes()
+*/
+typedef struct _spCheck {
+  spGen_t gen;    // regenerates the frame as it arrives
+  bool    bad;    // a byte did not match
+  size_t  badBit; // first bad bit in transmission order
+} spCheck_t;
+
+/*
+* Pipelined frame stream, see spWinRx() and spWinTx()
+*/
+typedef struct _spWin {
+  sem_t         credit; // one per frame the writer may still send
+  volatile bool stop;   // receiver is done, writer stops sending
+  u_int32       total;  // frames in the sweep
+  u_int32       ok;     // frames verified in sequence
+  u_int32       drop;   // sequence numbers never seen
+  u_int32       ooo;    // frames older than the last one seen
+  u_int32       bad;    // frames with a broken header or payload
+  float64       bytes;  // frame bytes verified
+} spWin_t;
+
 /*
 * Serial Port Test Data Description
 */
@@ -128,6 +190,33 @@ typedef struct _spDatDat {
   int32         fd_r, fd_w;                    // device descriptors
   spState_t     spSt_r, spSt_w;                // state of reader and writer
   bRate_t       *brp, *lbrp;                   // baud rate table pointers
+  spRxFrame_t   rxf;                           // receive reactor frame
+  sem_t         txRdy;                         // posted when the writer is waitingForRx
+  spWin_t       win;                           // pipelined frame stream
+  int32         id_r, id_w;                    // interned device IDs
+  spGen_t       gen;                           // payload generator
+  spCheck_t     chk;                           // payload check of the current frame
+  bRate_t       *plan;                         // only baud rate of this round, see spPlan()
+  volatile bool quit;                          // threads return when woken, see spStopDat()
+  struct _spDatDat *next;                      // next scheduled test
 } spDatDat_t;
 
-extern void initSerialPort(int32 fd,speed_t baudRate,spProt_t protocol,bool flowCntrl);
+/*
+* One baud rate of a cable in the sweep plan, see spPlan()
+*/
+typedef struct _spJob {
+  spDatDat_t *spdp[2]; // tests of the two directions, the second may be NULL
+  bRate_t    *brp[2];  // their statistics for this baud rate
+  u_int32     ports;   // one bit per spPorts[] index
+  bool        shared;  // uses a shared clock port
+  float64     wire;    // estimated seconds on the wire
+  u_int32     round;   // concurrent round, from 1
+} spJob_t;
+
+/*
+* Serial port layer, see serialLib.c
+*/
+extern int32 spOpen(const char *port,int32 flags);
+extern void  initSerialPort(int32 fd,speed_t baudRate,spProt_t protocol,bool flowCntrl);
+extern void  spCfgStats(u_int32 *applied,u_int32 *avoided);
+extern speed_t mapBaudTermios(u_int32 baud);
@@ -0,0 +1,871 @@
+/******************************************************************************
+                                  serialLib.c
+
+    Copyright (c) 2015-2017 Siemens Industry, Inc.
+    Original authors: Jack McCarthy, Andrew Valdez and Jonathan Grant
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the
+        Free Software Foundation, Inc.
+        51 Franklin Street, Fifth Floor
+        Boston MA  02110-1301 USA.
+
+*******************************************************************************/
+
+/* serialLib.c
+ *
+ * serialLib is the serial port layer shared by the serial clients. Ports
+ * are opened by basename through a backend and configured for a protocol
+ * and baud rate. The default backend opens the special devices under /dev.
+ * fit -P selects another device directory, or a simulated cable plant
+ * built from pseudo terminals so the serial clients run, and can be
+ * profiled, on any Linux host:
+ *
+ *   -P dev:/tmp/ports/                    special devices in /tmp/ports
+ *   -P sim:lat=200,flip=100000,cable=sp1-sp2
+ *
+ * Simulator options are separated by commas:
+ *
+ *   lat=usec     one way latency added to every chunk
+ *   flip=bits    one bit of every this many is inverted, 0 for none
+ *   baud=rate    line rate of every port, 0 (default) follows the port
+ *                settings and -1 does not throttle at all
+ *   cable=a-b    connects port a to port b, ports without a cable have
+ *                a loopback plug
+ *
+ * initSerialPort() keeps a shadow of what it last applied to every open
+ * port. A baud rate sweep reconfigures the ports for every rate and every
+ * iteration; when nothing changed the termios and SPX driver calls are
+ * skipped. spCfgStats() reports how many were applied and avoided.
+ *
+ */
+
+#define _GNU_SOURCE // pseudo terminals, posix_openpt() and friends
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <termios.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+
+#include "fit.h"
+#include "serialFit.h"
+
+#define SP_SIM_PORTS   16u  // simulated ports
+#define SP_SIM_CABLES   8u
+#define SP_SIM_CHUNK  256u  // bytes read from a port at once
+#define SP_SIM_QUEUE   64u  // chunks on the wire per port
+#define SP_SIM_POLL_MS 10   // how often new ports are picked up
+
+#define SP_CFG_FDS    256   // descriptors with a configuration shadow
+
+/*
+* Port backend, see fit -P
+*/
+typedef struct _spBackend {
+  const char *name;
+  int32 (*config)(const char *arg);            // backend options after the colon
+  int32 (*open)(const char *port,int32 flags); // port basename, returns a descriptor
+  int32 (*rate)(int32 fd,u_int32 rate);        // synchronous bit rate
+} spBackend_t;
+
+/*
+* Chunk of bytes on a simulated wire
+*/
+typedef struct _spSimChunk {
+  float64 due;                // delivery time, seconds
+  size_t  len, off;           // bytes and bytes already delivered
+  u_int8  buf[SP_SIM_CHUNK];
+} spSimChunk_t;
+
+/*
+* Simulated port, a pseudo terminal whose master side is the wire
+*/
+typedef struct _spSimPort {
+  char          name[8];
+  int32         master, slave;        // the slave is held open for the life of the port
+  dev_t         rdev;                 // identifies the descriptors of the clients
+  struct _spSimPort *peer;            // far end of the cable, NULL while unplugged
+  volatile u_int32 rate;              // synchronous bit rate, 0 for asynchronous
+  float64       free;                 // transmitter busy until
+  u_int32       bits;                 // bits sent since the last flipped one
+  spSimChunk_t  q[SP_SIM_QUEUE];      // chunks on the wire to the peer
+  u_int32       head, tail;
+} spSimPort_t;
+
+/*
+* Configuration last applied to a port, see initSerialPort()
+*/
+typedef struct _spCfg {
+  bool              termValid;  // term was applied
+  bool              rateValid;  // rate was applied
+  bool              spxValid;   // spx holds the driver configuration
+  struct termios    term;
+  u_int32           rate;       // synchronous bit rate
+  user_spx_ioctl_t  spx;        // ATC_SPXS_READ_CONFIG, 82XX only
+} spCfg_t;
+
+static int32 spDevConfig (const char *arg);
+static int32 spDevOpen (const char *port,int32 flags);
+static int32 set_spx_bit_rate (int32 fd,u_int32 rate);
+static int32 spSimConfig (const char *arg);
+static int32 spSimOpen (const char *port,int32 flags);
+static int32 spSimRate (int32 fd,u_int32 rate);
+
+static const spBackend_t spBackends[] = {
+  { "dev", spDevConfig, spDevOpen, set_spx_bit_rate },
+  { "sim", spSimConfig, spSimOpen, spSimRate },
+  { NULL,  NULL,        NULL,      NULL      }
+};
+
+static const spBackend_t *spBackend = NULL; // selected at the first open
+static pthread_mutex_t spLibLock = PTHREAD_MUTEX_INITIALIZER;
+
+static char spDevDir[64] = "/dev/";
+
+static spSimPort_t *spSimPorts[SP_SIM_PORTS];
+static u_int32      spSimCnt = 0u;
+static char         spSimCable[SP_SIM_CABLES][2][8];
+static u_int32      spSimCables = 0u;
+static float64      spSimLat = 0.0;  // seconds
+static u_int32      spSimFlip = 0u;  // bits per flipped bit
+static int32        spSimBaud = 0;   // 0 follows the port, -1 unthrottled
+static pthread_t    spSimTid;
+static bool         spSimRun = false;
+
+static spCfg_t         spCfg[SP_CFG_FDS];
+static u_int32         spCfgApplied = 0u, spCfgAvoided = 0u;
+static pthread_mutex_t spCfgLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+* Shadow of a descriptor, NULL when it has none, spCfgLock must be held
+*/
+static spCfg_t *spCfgFor (int32 fd)
+{
+  return (((fd >= 0) && (fd < (int32)SP_CFG_FDS)) ? &spCfg[fd] : NULL);
+}
+
+/*
+*
+* Special device backend
+*
+*/
+
+static int32 spDevConfig (const char *arg)
+{
+  if (strlen (arg) >= (sizeof(spDevDir) - 1u)) {
+    fitPrint(ERROR, "device directory %s is too long\n",arg);
+    return (-1);
+  }
+
+  strcpy (spDevDir,arg);
+  if ((spDevDir[0] != '\0') && (spDevDir[strlen (spDevDir) - 1u] != '/')) {
+    strcat (spDevDir,"/");
+  }
+
+  return (0);
+}
+
+static int32 spDevOpen (const char *port,int32 flags)
+{
+  char specialDevice[96]; // must be large enough
+
+  if ((strlen (spDevDir) + strlen (port)) >= sizeof(specialDevice)) {
+    errno = ENAMETOOLONG;
+    return (-1);
+  }
+
+  specialDevice[0] = '\0';
+  strcat (specialDevice,spDevDir);
+  strcat (specialDevice,port);
+
+  return (open (specialDevice,flags));
+}
+
+static int32 mapsdlcbaud(u_int32 rate)
+{
+    int32 cnt;
+
+    for(cnt = 0; cnt < 11; cnt++)
+    {
+      if (rate == ATC_B[cnt])
+      {
+        break;
+      }
+    }
+
+    if (cnt == 11)
+    {
+      fitPrint(ERROR, "%s Baudrate not supported", __func__);
+      cnt = -1;
+    }
+
+    return cnt;
+}
+
+/*
+* Set the new baud rate*
+* NOTE: if retVal is 0 or positive, it represents the old
+* rate. Otherwise, it is an error code.
+*/
+static int32 set_spx_bit_rate (int32 fd, u_int32 rate)
+{
+  int32    retVal = 0;
+  int32    tmprate;
+  user_spx_ioctl_t user_spx_ioctl_data;
+  atc_spxs_config_t spxs;
+  spCfg_t *cp = spCfgFor (fd); // initSerialPort() holds spCfgLock
+
+  switch(targetARCH) {
+    case ARCH_82XX:
+      if ((cp != NULL) && cp->spxValid) {
+        user_spx_ioctl_data = cp->spx; // only the rate changes, no need to read it back
+      } else {
+        memset(&user_spx_ioctl_data,0,sizeof(user_spx_ioctl_t));
+        retVal = ioctl (fd, ATC_SPXS_READ_CONFIG, &user_spx_ioctl_data);
+      }
+
+      if (retVal >= 0)
+      {
+        user_spx_ioctl_data.x[1] = rate; // new baud rate
+        retVal = ioctl (fd, ATC_SPXS_WRITE_CONFIG, &user_spx_ioctl_data);
+      }
+
+      if (cp != NULL) {
+        cp->spx = user_spx_ioctl_data;
+        cp->spxValid = (retVal >= 0);
+      }
+      break;
+    case ARCH_UNKNOWN:  // ATC 6
+    case ARCH_83XX:
+      spxs.protocol = 0;
+      tmprate = mapsdlcbaud(rate);
+      if (tmprate == -1)
+      {
+        retVal = -1;
+      }
+      else
+      {
+        spxs.baud = (u_int8)tmprate;
+        spxs.transmit_clock_source = 0;
+        spxs.transmit_clock_mode = 1;
+        retVal = ioctl (fd, ATC_SPXS_WRITE_CONFIG, &spxs);
+      }
+      break;
+    default:
+      retVal = -1;
+      break;
+  }
+
+  if (retVal < 0) {
+    fitPrint(ERROR, "set_spx_bit_rate: ioctl command %d failed, ret %ld, err %d, %s\n",
+             ATC_SPXS_WRITE_CONFIG,retVal,errno,strerror(errno));
+    return (retVal);
+  }
+  return (retVal);
+}
+
+/*
+*
+* Simulated cable plant
+*
+* Every simulated port is a pseudo terminal. The clients open the slave
+* side like a special device, termios included. The wire thread reads what
+* a client transmits from the master side and, after the wire time at the
+* line rate plus the latency, writes it to the master side of the far end.
+* One transmitter is busy until its previous chunk has left, so a port is
+* throttled to its line rate. A full wire stops the thread from reading
+* that port and the client sees the same back pressure as from a UART.
+*
+*/
+
+static float64 spSimNow (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC,&ts);
+  return ((float64)ts.tv_sec + ((float64)ts.tv_nsec / 1.0e9));
+}
+
+static u_int32 spSimSpeed (speed_t sp)
+{
+  u_int32 ret;
+
+  switch (sp) {
+    case B1200:   ret = 1200u;   break;
+    case B2400:   ret = 2400u;   break;
+    case B4800:   ret = 4800u;   break;
+    case B9600:   ret = 9600u;   break;
+    case B19200:  ret = 19200u;  break;
+    case B38400:  ret = 38400u;  break;
+    case B57600:  ret = 57600u;  break;
+    case B115200: ret = 115200u; break;
+    default:      ret = 0u;      break; // unthrottled
+  }
+
+  return (ret);
+}
+
+static int32 spSimConfig (const char *arg)
+{
+  char  opts[128];
+  char *cp, *np, *dp;
+
+  if (strlen (arg) >= sizeof(opts)) {
+    fitPrint(ERROR, "simulator options %s are too long\n",arg);
+    return (-1);
+  }
+
+  strcpy (opts,arg);
+
+  for (cp = opts; (cp != NULL) && (*cp != '\0'); cp = np) {
+    np = strchr (cp,',');
+    if (np != NULL) {
+      *np++ = '\0';
+    }
+
+    if (strncmp (cp,"lat=",4u) == 0) {
+      spSimLat = strtod (&cp[4],NULL) / 1.0e6;
+    } else if (strncmp (cp,"flip=",5u) == 0) {
+      spSimFlip = strtoul (&cp[5],NULL,10);
+    } else if (strncmp (cp,"baud=",5u) == 0) {
+      spSimBaud = strtol (&cp[5],NULL,10);
+    } else if ((strncmp (cp,"cable=",6u) == 0) &&
+               ((dp = strchr (&cp[6],'-')) != NULL) &&
+               (spSimCables < SP_SIM_CABLES) &&
+               (strlen (&cp[6]) < (2u * sizeof(spSimCable[0][0])))) {
+      *dp++ = '\0';
+      strncpy (spSimCable[spSimCables][0],&cp[6],sizeof(spSimCable[0][0]) - 1u);
+      strncpy (spSimCable[spSimCables][1],dp,sizeof(spSimCable[0][0]) - 1u);
+      spSimCables++;
+    } else {
+      fitPrint(ERROR, "unknown simulator option %s\n",cp);
+      return (-1);
+    }
+  }
+
+  return (0);
+}
+
+/*
+* Name of the far end of a port, the port itself for a loopback plug
+*/
+static const char *spSimPeerName (const char *port)
+{
+  u_int32 i;
+
+  for (i = 0u; i < spSimCables; i++) {
+    if (strcmp (spSimCable[i][0],port) == 0) {
+      return (spSimCable[i][1]);
+    }
+    if (strcmp (spSimCable[i][1],port) == 0) {
+      return (spSimCable[i][0]);
+    }
+  }
+
+  return (port);
+}
+
+/*
+* Wire time of a chunk, 0 when unthrottled
+*/
+static float64 spSimWire (const spSimPort_t *pp,size_t len)
+{
+  struct termios t;
+  u_int32 baud;
+  float64 bitsPerByte = 10.0;
+
+  if (spSimBaud < 0) {
+    return (0.0);
+  }
+
+  if (spSimBaud > 0) {
+    baud = (u_int32)spSimBaud;
+  } else if (pp->rate != 0u) {
+    baud = pp->rate;  // synchronous, no start and stop bits
+    bitsPerByte = 8.0;
+  } else if (tcgetattr (pp->slave,&t) == 0) {
+    baud = spSimSpeed (cfgetospeed (&t));
+  } else {
+    baud = 0u;
+  }
+
+  return ((baud == 0u) ? 0.0 : (((float64)len * bitsPerByte) / (float64)baud));
+}
+
+/*
+* Put what a port transmitted on the wire, with the bit errors of the line
+*/
+static void spSimSend (spSimPort_t *pp)
+{
+  spSimChunk_t *cp = &pp->q[pp->tail % SP_SIM_QUEUE];
+  ssize_t bCnt;
+  size_t  i;
+  float64 now;
+
+  bCnt = read (pp->master,cp->buf,sizeof(cp->buf));
+  if (bCnt <= 0) {
+    return;
+  }
+
+  cp->len = (size_t)bCnt;
+  cp->off = 0u;
+
+  if (spSimFlip != 0u) {
+    for (i = 0u; i < cp->len; i++) {
+      pp->bits += 8u;
+      if (pp->bits >= spSimFlip) {
+        pp->bits -= spSimFlip;
+        cp->buf[i] ^= (u_int8)(1u << (pp->bits & 7u));
+      }
+    }
+  }
+
+  now = spSimNow ();
+  pp->free = MAX(pp->free,now) + spSimWire (pp,cp->len);
+  cp->due  = pp->free + spSimLat;
+  pp->tail++;
+}
+
+/*
+* Hand the chunks that have arrived to the far end, returns the time of
+* the next arrival or 0 when the wire is empty
+*/
+static float64 spSimDeliver (spSimPort_t *pp,float64 now)
+{
+  spSimChunk_t *cp;
+  ssize_t bCnt;
+
+  while (pp->head != pp->tail) {
+    cp = &pp->q[pp->head % SP_SIM_QUEUE];
+    if (cp->due > now) {
+      return (cp->due);
+    }
+
+    if (pp->peer != NULL) {
+      bCnt = write (pp->peer->master,&cp->buf[cp->off],cp->len - cp->off);
+      if ((bCnt == -1) && (errno == EAGAIN)) {
+        return (now + 0.001); // the far end is not reading, try again
+      }
+
+      if ((bCnt > 0) && ((size_t)bCnt < (cp->len - cp->off))) {
+        cp->off += (size_t)bCnt;
+        continue;
+      }
+    }
+
+    pp->head++; // delivered, or dropped on an unplugged cable
+  }
+
+  return (0.0);
+}
+
+static void *spSimWireThread (void *vp)
+{
+  struct pollfd fds[SP_SIM_PORTS];
+  spSimPort_t  *pp[SP_SIM_PORTS];
+  u_int32 i, n, cnt;
+  float64 now, due, next;
+  int32   tmo;
+
+  (void)vp;
+
+  while (spSimRun) {
+    pthread_mutex_lock (&spLibLock);
+    cnt = spSimCnt;
+    pthread_mutex_unlock (&spLibLock);
+
+    now  = spSimNow ();
+    next = 0.0;
+
+    for (i = 0u, n = 0u; i < cnt; i++) {
+      due = spSimDeliver (spSimPorts[i],now);
+      if ((due != 0.0) && ((next == 0.0) || (due < next))) {
+        next = due;
+      }
+
+      if ((spSimPorts[i]->tail - spSimPorts[i]->head) < SP_SIM_QUEUE) {
+        pp[n] = spSimPorts[i];
+        fds[n].fd = spSimPorts[i]->master;
+        fds[n].events = POLLIN;
+        fds[n].revents = 0;
+        n++;
+      }
+    }
+
+    tmo = SP_SIM_POLL_MS;
+    if (next != 0.0) {
+      tmo = MIN(tmo,(int32)((next - now) * 1.0e3));
+    }
+
+    if (poll (fds,(nfds_t)n,tmo) <= 0) {
+      continue;
+    }
+
+    for (i = 0u; i < n; i++) {
+      if ((fds[i].revents & POLLIN) != 0) {
+        spSimSend (pp[i]);
+      }
+    }
+  }
+
+  return (NULL);
+}
+
+/*
+* Find or create a simulated port, called with spLibLock held
+*/
+static spSimPort_t *spSimPort (const char *port)
+{
+  spSimPort_t *pp;
+  struct termios t;
+  struct stat st;
+  const char *peer;
+  const char *pts;
+  u_int32 i;
+
+  for (i = 0u; i < spSimCnt; i++) {
+    if (strcmp (spSimPorts[i]->name,port) == 0) {
+      return (spSimPorts[i]);
+    }
+  }
+
+  if ((spSimCnt == SP_SIM_PORTS) || (strlen (port) >= sizeof(pp->name))) {
+    errno = ENOSPC;
+    return (NULL);
+  }
+
+  pp = calloc (1u,sizeof(spSimPort_t));
+  if (pp == NULL) {
+    return (NULL);
+  }
+
+  strcpy (pp->name,port);
+  pp->master = posix_openpt (O_RDWR | O_NOCTTY | O_NONBLOCK);
+  pp->slave  = -1;
+
+  if ((pp->master != -1) && (grantpt (pp->master) == 0) && (unlockpt (pp->master) == 0) &&
+      ((pts = ptsname (pp->master)) != NULL)) {
+    pp->slave = open (pts,O_RDWR | O_NOCTTY);
+  }
+
+  if ((pp->slave == -1) || (fstat (pp->slave,&st) != 0)) {
+    fitPrint(ERROR, "cannot create simulated port %s, err %d, %s\n",port,errno,strerror(errno));
+    if (pp->master != -1) {
+      close (pp->master);
+    }
+    free (pp);
+    return (NULL);
+  }
+
+  pp->rdev = st.st_rdev;
+
+  if (tcgetattr (pp->slave,&t) == 0) {
+    cfmakeraw (&t); // until a client configures the port
+    (void) tcsetattr (pp->slave,TCSANOW,&t);
+  }
+
+  /*
+  * Plug in the cable
+  */
+  peer = spSimPeerName (port);
+  if (strcmp (peer,port) == 0) {
+    pp->peer = pp;
+  } else {
+    for (i = 0u; i < spSimCnt; i++) {
+      if (strcmp (spSimPorts[i]->name,peer) == 0) {
+        pp->peer = spSimPorts[i];
+        spSimPorts[i]->peer = pp;
+      }
+    }
+  }
+
+  spSimPorts[spSimCnt++] = pp;
+  fitPrint(VERBOSE, "simulated port %s is %s, cabled to %s\n",port,ptsname (pp->master),peer);
+
+  if (!spSimRun) {
+    spSimRun = true;
+    if (pthread_create (&spSimTid,NULL,spSimWireThread,NULL) != 0) {
+      spSimRun = false;
+      fitPrint(ERROR, "cannot start the simulated wire, err %d, %s\n",errno,strerror(errno));
+    } else {
+      (void) pthread_detach (spSimTid);
+    }
+  }
+
+  return (pp);
+}
+
+static int32 spSimOpen (const char *port,int32 flags)
+{
+  const spSimPort_t *pp;
+  int32 fd = -1;
+
+  pthread_mutex_lock (&spLibLock);
+  pp = spSimPort (port);
+  if (pp != NULL) {
+    fd = open (ptsname (pp->master),flags | O_NOCTTY);
+  }
+  pthread_mutex_unlock (&spLibLock);
+
+  return (fd);
+}
+
+static int32 spSimRate (int32 fd,u_int32 rate)
+{
+  struct stat st;
+  u_int32 i;
+
+  if (fstat (fd,&st) != 0) {
+    return (-1);
+  }
+
+  pthread_mutex_lock (&spLibLock);
+  for (i = 0u; i < spSimCnt; i++) {
+    if (spSimPorts[i]->rdev == st.st_rdev) {
+      spSimPorts[i]->rate = rate;
+    }
+  }
+  pthread_mutex_unlock (&spLibLock);
+
+  return (0);
+}
+
+/*
+*
+* Serial port layer
+*
+*/
+
+/*
+* Select the backend named by fit -P, once
+*/
+static int32 spBackendInit (void)
+{
+  const char *spec = (ftPortSpec != NULL) ? ftPortSpec : "dev";
+  const char *arg;
+  size_t len;
+  int32  ret = 0;
+
+  pthread_mutex_lock (&spLibLock);
+
+  if (spBackend == NULL) {
+    arg = strchr (spec,':');
+    len = (arg != NULL) ? (size_t)(arg - spec) : strlen (spec);
+
+    for (spBackend = spBackends; spBackend->name != NULL; spBackend++) {
+      if ((strlen (spBackend->name) == len) && (strncmp (spBackend->name,spec,len) == 0)) {
+        break;
+      }
+    }
+
+    if (spBackend->name == NULL) {
+      fitPrint(ERROR, "unknown serial port backend %s\n",spec);
+      ret = -1;
+    } else if ((arg != NULL) && (spBackend->config (&arg[1]) != 0)) {
+      ret = -1;
+    }
+
+    if (ret != 0) {
+      spBackend = &spBackends[0]; // the special devices
+    }
+  }
+
+  pthread_mutex_unlock (&spLibLock);
+  return (ret);
+}
+
+/*
+* Open a serial port by its basename, e.g. sp1, returns a descriptor or -1
+*/
+int32 spOpen(const char *port, int32 flags)
+{
+  spCfg_t *cp;
+  int32 fd;
+
+  if (spBackendInit () != 0) {
+    errno = EINVAL;
+    return (-1);
+  }
+
+  fd = spBackend->open (port,flags);
+
+  pthread_mutex_lock (&spCfgLock);
+  cp = spCfgFor (fd);
+  if (cp != NULL) {
+    memset (cp,0,sizeof(*cp)); // a new port, whatever closed this descriptor before
+  }
+  pthread_mutex_unlock (&spCfgLock);
+
+  return (fd);
+}
+
+/*
+* Port configurations applied and avoided since the last call
+*/
+void spCfgStats (u_int32 *applied,u_int32 *avoided)
+{
+  pthread_mutex_lock (&spCfgLock);
+  *applied = spCfgApplied;
+  *avoided = spCfgAvoided;
+  spCfgApplied = 0u;
+  spCfgAvoided = 0u;
+  pthread_mutex_unlock (&spCfgLock);
+}
+
+/*
+* Termios speed of a baud rate, synchronous rates pass through
+*/
+speed_t mapBaudTermios (u_int32 baud)
+{
+  speed_t ret;
+
+  switch (baud)
+  {
+    case 1200:
+      ret = (B1200);
+      break;
+    case 2400:
+      ret = (B2400);
+      break;
+    case 4800:
+      ret = (B4800);
+      break;
+    case 9600:
+      ret = (B9600);
+      break;
+    case 19200:
+      ret = (B19200);
+      break;
+    case 38400:
+      ret = (B38400);
+      break;
+    case 57600:
+      ret = (B57600);
+      break;
+    case 115200:
+      ret = (B115200);
+      break;
+    default:
+      // 153600 sdlc
+      // 614400 sdlc
+      ret = ((speed_t)baud);
+      break;
+  }
+  return (ret);
+}
+
+#ifdef DUMP_TERMIOS
+static void dumpTermios(const struct termios *tp)
+{
+  int32 i;
+  fprintf(stderr,"Size of flags is %u\n", sizeof(tp->c_cflag));
+  fprintf(stderr,"%s:\tiflags:%o oflags:%o cflags:%o \n",
+          __func__,tp->c_iflag,tp->c_oflag,tp->c_cflag);
+  fprintf(stderr,"\t\tlflags:0x%x line-disc:%u ispeed:%u ospeed:%u\n",
+         tp->c_lflag,tp->c_line,tp->c_ispeed,tp->c_ospeed);
+  fprintf(stderr,"%s: control chars:",__func__);
+  for(i=0;i<NCCS;i++)
+    fprintf(stderr," %02x",tp->c_cc[i]);
+  fprintf(stderr,"\n");
+}
+#endif
+
+static bool spTermSame (const struct termios *a,const struct termios *b)
+{
+  return ((a->c_iflag == b->c_iflag) && (a->c_oflag == b->c_oflag) &&
+          (a->c_cflag == b->c_cflag) && (a->c_lflag == b->c_lflag) &&
+          (a->c_line == b->c_line) &&
+          (cfgetispeed (a) == cfgetispeed (b)) && (cfgetospeed (a) == cfgetospeed (b)) &&
+          (memcmp (a->c_cc,b->c_cc,sizeof(a->c_cc)) == 0));
+}
+
+void initSerialPort (int32 fd,speed_t baudRate,spProt_t protocol,bool flowCntrl)
+{
+  struct termios t;
+  spCfg_t *cp;
+  bool     applied = false;
+
+  pthread_mutex_lock (&spCfgLock);
+  cp = spCfgFor (fd);
+
+  if ((cp != NULL) && cp->termValid) {
+    t = cp->term; // what the driver has, without asking it
+  } else {
+    tcgetattr (fd,&t);
+  }
+
+  cfmakeraw (&t);
+
+  t.c_cc[VMIN]  = 1;
+  t.c_cc[VTIME] = 2;
+
+  if (flowCntrl) {
+     t.c_cflag |= CRTSCTS;
+  }
+
+  switch (protocol) {
+    case protAsync:
+      /*
+      * TODO: change interface to verify independent input/output rates.
+      */
+      (void) cfsetispeed (&t,baudRate);
+      (void) cfsetospeed (&t,baudRate);
+      break;
+    case protSync:
+      if ((cp == NULL) || !cp->rateValid || (cp->rate != (u_int32)baudRate)) {
+        (void) spBackendInit ();
+        if ((spBackend->rate (fd,baudRate) >= 0) && (cp != NULL)) {
+          cp->rate = (u_int32)baudRate;
+          cp->rateValid = true;
+        }
+        applied = true;
+      }
+      break;
+    case protNone:
+    default:
+      // nothing to do
+      break;
+  }
+
+  (void) tcflush (fd,TCIOFLUSH); // Flush the input and output
+
+  if ((cp == NULL) || !cp->termValid || !spTermSame (&t,&cp->term)) {
+    #ifdef DUMP_TERMIOS
+    dumpTermios(&t);
+    #endif
+
+    if ((tcsetattr (fd,TCSANOW,&t) == 0) && (cp != NULL)) {
+      cp->term = t;
+      cp->termValid = true;
+    }
+    applied = true;
+  }
+
+  if (applied) {
+    spCfgApplied++;
+  } else {
+    spCfgAvoided++;
+  }
+
+  pthread_mutex_unlock (&spCfgLock);
+}
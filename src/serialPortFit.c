@@ -31,6 +31,8 @@
 #include <errno.h>
 #include <unistd.h>
 #include <termios.h>
+#include <time.h>
+#include <pthread.h>
 #include <semaphore.h>
 #include <sys/stat.h>
 
@@ -43,8 +45,12 @@
 #define COMSZ  32 // byte count
 #define MAX_COMM_SZ 1024u
 #define DEV_NAME_SZ 32
-#define TXDEV "/dev/sp8"
-#define RXDEV "/dev/sp8"
+#define TXDEV "sp8"
+#define RXDEV "sp8"
+#define SOAK_BUF   65536u // receive buffer of the soak test
+#define SOAK_BATCH    16u // asynchronous frames per write
+#define SOAK_HDR       6u // sync bytes and sequence number
+#define SOAK_QUIET     1  // seconds without data that end the soak receiver
 
 typedef struct _comm_t
 {
@@ -67,6 +73,28 @@ static int32 fd_r,fd_w;
 static spProt_t spProtocol = protNone;
 static speed_t spBaudRate;
 
+/*
+* Soak test, see -d
+*/
+typedef struct _soak_t
+{
+  pthread_mutex_t lock;    // counters, against the reports
+  volatile bool   stop;    // the writer stops, the receiver once the line is quiet
+  float64 txBytes,rxBytes;
+  u_int32 txFrames;
+  u_int32 ok;              // frames received intact
+  u_int32 lost;            // sequence numbers never received intact
+  u_int32 resync;          // the receiver lost the frame boundary
+  u_int32 errors;          // failed reads and writes
+  u_int32 expect;          // next sequence number
+  bool    synced;          // the receiver is on a frame boundary
+  struct timespec rxLast;  // CLOCK_MONOTONIC of the last data received
+} soak_t;
+
+static soak_t soak = {PTHREAD_MUTEX_INITIALIZER};
+static u_char soakRx[SOAK_BUF];
+static u_char soakTx[SOAK_BATCH * MAX_COMM_SZ];
+
 
 static void usage(char * cp)
 {
@@ -91,10 +119,17 @@ sp2 sp1 1 32 10\n\
 \n\
 The arguments and functionality are defined as:\n\
 \t-i specifies the number of overall test iterations.\n\
+\t-b baud rate, 115200 for asynchronous and 153600 for synchronous ports\n\
+\t   by default.\n\
+\t-d soak test for this many seconds. The line is kept saturated with\n\
+\t   sequence numbered frames of the payload size (8 bytes at least) by a\n\
+\t   writer thread while a receiver thread checks them as they arrive.\n\
+\t   Byte and frame rates, frames lost or damaged and the error rate are\n\
+\t   reported on one line every -p seconds (default 10) and for the run.\n\
 \t-c configuration file name\n\
 \t-h this help\n\
 ";
-  fitPrint(USER,  "usage: %s [i[iteration]c[config file]h]\n%s\n",cp,us);
+  fitPrint(USER,  "usage: %s [i[iteration]b[baud rate]d[seconds]p[seconds]c[config file]h]\n%s\n",cp,us);
   fitLicense();
   exit(0);
 }
@@ -203,6 +238,350 @@ eagain2:
   return(ftRxError);
 }
 
+/*
+* Soak frame: 0xa5 0x5a, big endian sequence number, then the folded
+* sequence number + offset, so a damaged number does not check either
+*/
+static u_char soakFold(u_int32 seq)
+{
+  return((u_char)(seq ^ (seq >> 8) ^ (seq >> 16) ^ (seq >> 24)));
+}
+
+static void soakFrame(u_char *p,u_int32 seq)
+{
+  const u_char f = soakFold(seq);
+  size_t k;
+
+  p[0] = 0xa5u;
+  p[1] = 0x5au;
+  p[2] = (u_char)(seq >> 24);
+  p[3] = (u_char)(seq >> 16);
+  p[4] = (u_char)(seq >> 8);
+  p[5] = (u_char)seq;
+
+  for(k = SOAK_HDR; k < commp->comSz; k++)
+  {
+    p[k] = (u_char)(f + k);
+  }
+}
+
+static bool soakCheck(const u_char *p,u_int32 *seqp)
+{
+  u_int32 seq;
+  u_char  f;
+  size_t  k;
+
+  if((p[0] != 0xa5u) || (p[1] != 0x5au))
+  {
+    return(false);
+  }
+
+  seq = ((u_int32)p[2] << 24) | ((u_int32)p[3] << 16) | ((u_int32)p[4] << 8) | (u_int32)p[5];
+
+  f = soakFold(seq);
+
+  for(k = SOAK_HDR; k < commp->comSz; k++)
+  {
+    if(p[k] != (u_char)(f + k))
+    {
+      return(false);
+    }
+  }
+
+  *seqp = seq;
+  return(true);
+}
+
+/*
+* Account for the complete frames in the receive buffer, soak.lock held.
+* After a damaged frame the receiver slides a byte at a time until a frame
+* checks again, the sequence numbers in between count as lost.
+*/
+static size_t soakScan(size_t len)
+{
+  size_t  pos = 0u;
+  u_int32 seq;
+
+  while((len - pos) >= commp->comSz)
+  {
+    if(soakCheck(&soakRx[pos],&seq))
+    {
+      if(seq < soak.expect)
+      {
+        soak.resync++; // stale, the far end must have repeated it
+      }
+      else
+      {
+        soak.lost += seq - soak.expect;
+        soak.ok++;
+        soak.expect = seq + 1u;
+      }
+      soak.synced = true;
+      pos += commp->comSz;
+    }
+    else
+    {
+      if(soak.synced)
+      {
+        soak.resync++;
+        soak.synced = false;
+      }
+      pos++;
+    }
+  }
+
+  memmove(soakRx,&soakRx[pos],len - pos);
+  return(len - pos);
+}
+
+static void *soakWriter(void *vp)
+{
+  const size_t batch = (spProtocol == protSync) ? 1u : SOAK_BATCH; // a synchronous write is one frame
+  const size_t n = batch * commp->comSz;
+  u_int32 seq = 0u;
+  size_t  i,off;
+  ssize_t bCnt;
+
+  (void) vp;
+
+  while(!soak.stop)
+  {
+    for(i = 0u; i < batch; i++)
+    {
+      soakFrame(&soakTx[i * commp->comSz],seq++);
+    }
+
+    for(off = 0u; off < n; off += (size_t)bCnt)
+    {
+      bCnt = write(fd_w,&soakTx[off],n - off);
+      if(bCnt == -1)
+      {
+        if(errno == EINTR)
+        {
+          bCnt = 0;
+          continue;
+        }
+        fitPrint(ERROR, "cannot write from %s, err %d, fd %ld, %s\n",
+                 commp->devName_w,errno,fd_w,strerror(errno));
+        soak.stop = true;
+        break;
+      }
+    }
+
+    pthread_mutex_lock(&soak.lock);
+    soak.txBytes += (float64)off;
+    soak.txFrames += (u_int32)(off / commp->comSz);
+    soak.errors += (off != n) ? 1u : 0u;
+    pthread_mutex_unlock(&soak.lock);
+  }
+
+  return(NULL);
+}
+
+static void *soakReader(void *vp)
+{
+  fd_set  rfds;
+  struct timeval tv;
+  size_t  len = 0u;
+  ssize_t bCnt;
+  int32   retval;
+
+  (void) vp;
+
+  while(true)
+  {
+    FD_ZERO(&rfds);
+    FD_SET(fd_r,&rfds);
+    tv.tv_sec = SOAK_QUIET;
+    tv.tv_usec = 0;
+
+    retval = select(fd_r + 1,&rfds,NULL,NULL,&tv);
+
+    if(retval == 0)
+    {
+      if(soak.stop)
+      {
+        break; // the last frame has arrived
+      }
+      continue;
+    }
+
+    if(retval < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      fitPrint(ERROR, "Receiver %s select failed, err %d, %s\n",
+               commp->devName_r,errno,strerror(errno));
+      break;
+    }
+
+    bCnt = read(fd_r,&soakRx[len],sizeof(soakRx) - len);
+
+    pthread_mutex_lock(&soak.lock);
+    if(bCnt > 0)
+    {
+      (void) clock_gettime(CLOCK_MONOTONIC,&soak.rxLast);
+      soak.rxBytes += (float64)bCnt;
+      len = soakScan(len + (size_t)bCnt);
+    }
+    else if((bCnt == -1) && (errno != EAGAIN) && (errno != EINTR))
+    {
+      soak.errors++;
+    }
+    pthread_mutex_unlock(&soak.lock);
+  }
+
+  if(!soak.stop)
+  {
+    pthread_mutex_lock(&soak.lock);
+    soak.errors++;
+    pthread_mutex_unlock(&soak.lock);
+  }
+
+  return(NULL);
+}
+
+/*
+* One line summary of the soak test since the previous one
+*/
+static void soakReport(const char *what,float64 secs,const soak_t *now,const soak_t *prev)
+{
+  const u_int32 lost = now->lost - prev->lost;
+  const u_int32 ok = now->ok - prev->ok;
+
+  fitPrint(VERBOSE, "%s->%s %s %7.0fS TX %9.1f B/S RX %9.1f B/S %8.1f FRAMES/S OK %lu LOST %lu RESYNC %lu ERR RATE %.2e\n",
+           commp->devName_w,commp->devName_r,what,secs,
+           (now->txBytes - prev->txBytes) / secs,(now->rxBytes - prev->rxBytes) / secs,
+           (float64)ok / secs,ok,lost,now->resync - prev->resync,
+           ((ok + lost) != 0u) ? ((float64)lost / (float64)(ok + lost)) : 0.0);
+}
+
+static float64 soakSecs(const struct timespec *a,const struct timespec *b)
+{
+  return((float64)(b->tv_sec - a->tv_sec) + ((float64)(b->tv_nsec - a->tv_nsec) * 1.0e-9));
+}
+
+/*
+*
+* Soak test
+*
+* The writer keeps the line saturated with sequence numbered frames, the
+* receiver checks them as they arrive. Both run until the duration is up,
+* the receiver until the frames in flight have arrived too.
+*
+*/
+static ftRet_t soakTest(u_int32 duration,u_int32 period)
+{
+  struct timespec start,now,last;
+  pthread_t tid_r,tid_w;
+  soak_t    snap,prev,zero;
+  ftRecord_t rec;
+  ftRet_t   ret;
+
+  pthread_mutex_lock(&soak.lock);
+  soak.stop = false;
+  soak.txBytes = 0.0;
+  soak.rxBytes = 0.0;
+  soak.txFrames = 0u;
+  soak.ok = 0u;
+  soak.lost = 0u;
+  soak.resync = 0u;
+  soak.errors = 0u;
+  soak.expect = 0u;
+  soak.synced = false;
+  soak.rxLast.tv_sec = 0;
+  soak.rxLast.tv_nsec = 0;
+  prev = soak;
+  zero = soak;
+  pthread_mutex_unlock(&soak.lock);
+
+  if(pthread_create(&tid_r,NULL,soakReader,NULL) != 0)
+  {
+    fitPrint(ERROR, "cannot start the soak receiver, err %d, %s\n",errno,strerror(errno));
+    return(ftUpdateTestStatus(ftrp,ftError,NULL));
+  }
+
+  if(pthread_create(&tid_w,NULL,soakWriter,NULL) != 0)
+  {
+    fitPrint(ERROR, "cannot start the soak writer, err %d, %s\n",errno,strerror(errno));
+    soak.stop = true;
+    (void) pthread_join(tid_r,NULL);
+    return(ftUpdateTestStatus(ftrp,ftError,NULL));
+  }
+
+  fitPrint(VERBOSE, "soaking %s->%s for %lu seconds, %u byte frames\n",
+           commp->devName_w,commp->devName_r,duration,commp->comSz);
+
+  clock_gettime(CLOCK_MONOTONIC,&start);
+  last = start;
+  now = start;
+
+  while(keepGoing && !soak.stop && (soakSecs(&start,&now) < (float64)duration))
+  {
+    sleep(1);
+    clock_gettime(CLOCK_MONOTONIC,&now);
+
+    if(soakSecs(&last,&now) >= (float64)period)
+    {
+      pthread_mutex_lock(&soak.lock);
+      snap = soak;
+      pthread_mutex_unlock(&soak.lock);
+
+      soakReport("    ",soakSecs(&last,&now),&snap,&prev);
+      prev = snap;
+      last = now;
+    }
+  }
+
+  soak.stop = true;
+  (void) pthread_join(tid_w,NULL);
+  (void) pthread_join(tid_r,NULL);
+
+  pthread_mutex_lock(&soak.lock);
+  snap = soak;
+  pthread_mutex_unlock(&soak.lock);
+
+  if(soakSecs(&now,&snap.rxLast) > 0.0)
+  {
+    now = snap.rxLast; // the run ends with the frames drained after the deadline
+  }
+
+  soakReport("ALL ",soakSecs(&start,&now),&snap,&zero);
+
+  if(snap.errors != 0u)
+  {
+    ret = ftRxError;
+  }
+  else if(snap.ok == 0u)
+  {
+    ret = ftRxTimeout;
+  }
+  else if((snap.lost != 0u) || (snap.resync != 0u))
+  {
+    ret = ftRxFail;
+  }
+  else
+  {
+    ret = ftPass;
+  }
+
+  memset(&rec,0,sizeof(rec));
+  rec.event  = "soak";
+  rec.rx     = commp->devName_r;
+  rec.tx     = commp->devName_w;
+  rec.size   = commp->comSz;
+  rec.result = ret;
+  rec.okCnt  = snap.ok;
+  rec.ngCnt  = snap.lost;
+  rec.start  = start;
+  rec.end    = now;
+  ftRecord(&rec); // run summary, see fit -R
+
+  return(ftUpdateTestStatus(ftrp,ret,NULL));
+}
+
 ftRet_t serialPortFit(plint argc, char *const argv[])
 {
   u_int32 i;
@@ -210,6 +589,9 @@ ftRet_t serialPortFit(plint argc, char *const argv[])
   u_int32 unused_min_size;
   char    lcl_devName_r[DEV_NAME_SZ],lcl_devName_w[DEV_NAME_SZ];
   FILE    *fp;
+  u_int32 rate = 0u;       // -b
+  u_int32 soakSecsArg = 0u; // -d
+  u_int32 period = RXTMO;  // -p
 
   /*
   * Set defaults
@@ -224,7 +606,7 @@ ftRet_t serialPortFit(plint argc, char *const argv[])
   * Parse command line arguments
   */
   opterr = 0;
-  c = getopt(argc,argv,"c:i:h");
+  c = getopt(argc,argv,"c:i:b:d:p:h");
 
   while(c != -1){
     switch((char)c){
@@ -261,10 +643,8 @@ ftRet_t serialPortFit(plint argc, char *const argv[])
           spBaudRate = B115200;
         }
 
-        strcpy(commp->devName_r,"/dev/");
-        strcat(commp->devName_r,lcl_devName_r);
-        strcpy(commp->devName_w,"/dev/");
-        strcat(commp->devName_w,lcl_devName_w);
+        strcpy(commp->devName_r,lcl_devName_r);
+        strcpy(commp->devName_w,lcl_devName_w);
 
         if (commp->comSz > MAX_COMM_SZ)
         {
@@ -276,15 +656,36 @@ ftRet_t serialPortFit(plint argc, char *const argv[])
       case 'i': // number of test iterations
         commp->iter = strtoul(optarg,NULL,10);
         break;
+      case 'b': // baud rate
+        rate = strtoul(optarg,NULL,10);
+        break;
+      case 'd': // soak test seconds
+        soakSecsArg = strtoul(optarg,NULL,10);
+        break;
+      case 'p': // soak report period
+        period = MAX(strtoul(optarg,NULL,10),1u);
+        break;
     } // switch()
 
-    c = getopt(argc,argv,"c:i:h");
+    c = getopt(argc,argv,"c:i:b:d:p:h");
   } // while()
 
   for(idx = optind; idx < argc; idx++){
     fitPrint(ERROR, "Non-option argument %s\n",argv[idx]);
   }
 
+  ftArgsDone();
+
+  if(rate != 0u)
+  {
+    spBaudRate = (spProtocol == protSync) ? (speed_t)rate : mapBaudTermios(rate);
+  }
+
+  if((soakSecsArg != 0u) && (commp->comSz < (SOAK_HDR + 2u)))
+  {
+    commp->comSz = SOAK_HDR + 2u; // room for the header and some payload
+  }
+
   fitPrint(VERBOSE, "Using config TX %s, RX %s, packet size %u, iteration %lu\n",
            commp->devName_w,commp->devName_r,commp->comSz,commp->iter);
 
@@ -293,7 +694,7 @@ ftRet_t serialPortFit(plint argc, char *const argv[])
   */
   if(strcmp(commp->devName_r,commp->devName_w) == 0)
   { // loopback: same port for transmit and receive
-    fd_w = open(commp->devName_w,O_RDWR);
+    fd_w = spOpen(commp->devName_w,O_RDWR);
 
     if(fd_w == -1){
       fitPrint(ERROR, "%s: cannot open %s, err %d, %s\n",
@@ -307,7 +708,7 @@ ftRet_t serialPortFit(plint argc, char *const argv[])
   }
   else
   { // port to port: different port for transmit and receive
-    fd_w = open(commp->devName_w,O_WRONLY);
+    fd_w = spOpen(commp->devName_w,O_WRONLY);
 
     if(fd_w == -1){
       fitPrint(ERROR, "%s: cannot open transmitter %s, err %d, %s\n",
@@ -316,7 +717,7 @@ ftRet_t serialPortFit(plint argc, char *const argv[])
       return(ftUpdateTestStatus(ftrp,ftComplete,commp->devName_w));
     }
 
-    fd_r = open(commp->devName_r,O_RDONLY);
+    fd_r = spOpen(commp->devName_r,O_RDONLY);
 
     if(fd_r == -1){
       fitPrint(ERROR, "%s: cannot open receiver %s, err %d, %s\n",
@@ -329,6 +730,12 @@ ftRet_t serialPortFit(plint argc, char *const argv[])
     initSerialPort(fd_w,spBaudRate,spProtocol,false);
   }
 
+  if(soakSecsArg != 0u)
+  {
+    (void) soakTest(soakSecsArg,period);
+    commp->iter = 0u; // instead of the frames
+  }
+
   for(i=0;i < commp->iter;i++){
     // initialize receive buffer
     memset(commp->buf_r,0xff,commp->comSz);